@@ -0,0 +1,59 @@
+/*
+ * \brief  Lima-specific conventions of the GPU session
+ * \date   2026-10-17
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU Affero General Public License version 3.
+ */
+
+#ifndef _INCLUDE__GPU__LIMA_SESSION_H_
+#define _INCLUDE__GPU__LIMA_SESSION_H_
+
+#include <base/stdint.h>
+#include <gpu_session/gpu_session.h>
+
+namespace Gpu {
+
+	struct Va_info;
+	struct In_sync;
+}
+
+
+/*
+ * GPU virtual address chosen by the driver
+ *
+ * If 'map_gpu' is called with a virtual address of 0, the driver places
+ * the buffer object and stores the address at 'OFFSET' within the info
+ * dataspace.
+ */
+struct Gpu::Va_info
+{
+	enum { OFFSET = 2048 };
+
+	Genode::uint64_t va;
+};
+
+
+/*
+ * In-sync entry of a submit
+ *
+ * An entry with 'VRAM_FENCE' set names the Vram id of a buffer, as
+ * imported via 'import_vram', instead of a sync object. The job then
+ * depends on the last job that used the buffer in the session that
+ * exported it.
+ */
+struct Gpu::In_sync
+{
+	enum : Genode::uint32_t { VRAM_FENCE = 1u << 31 };
+
+	static Genode::uint32_t vram_fence(Vram_id id)
+	{
+		return Genode::uint32_t(id.value) | VRAM_FENCE;
+	}
+};
+
+#endif /* _INCLUDE__GPU__LIMA_SESSION_H_ */
@@ -0,0 +1,274 @@
+/*
+ * \brief  Sample-conversion kernels
+ * \date   2026-10-17
+ *
+ * The kernels convert between the float samples of the session interfaces
+ * and the interleaved S16 stereo frames transferred by the DMA controller,
+ * and accumulate the samples of multiple sessions. Each kernel exists as
+ * scalar reference, as generic version based on the compiler's vector
+ * extension, and as NEON version. All versions saturate to the S16 range
+ * and produce identical results for finite input, except for the rounding
+ * of a fused multiply-add when accumulating.
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is distributed under the terms of the GNU General Public License
+ * version 2.
+ */
+
+#ifndef _CONVERT_H_
+#define _CONVERT_H_
+
+/* Genode includes */
+#include <base/stdint.h>
+#include <util/string.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace Audio { namespace Convert {
+
+	using Genode::int16_t;
+	using Genode::int32_t;
+
+	struct Scalar;
+	struct Vector;
+	struct Neon;
+
+	/* scale of the float samples in the range of [-1.0, 1.0] */
+	static constexpr float S16_SCALE = 32767.0f;
+
+	/* the sum of both channels is scaled to [-1.0, 1.0] on mixing */
+	static constexpr float MIX_SCALE = 1.0f/65536;
+} }
+
+
+struct Audio::Convert::Scalar
+{
+	static int16_t s16(float v)
+	{
+		float const s = v*S16_SCALE;
+
+		if (s != s)        return 0; /* NaN */
+		if (s >=  32767.0f) return  32767;
+		if (s <= -32768.0f) return -32768;
+
+		return int16_t(s);
+	}
+
+	/**
+	 * Interleave two float channels into S16 stereo frames
+	 *
+	 * \param right  may be nullptr, which results in a silent channel
+	 */
+	static void float_to_s16_stereo(int16_t *dst, float const *left,
+	                                float const *right, unsigned frames)
+	{
+		for (unsigned i = 0; i < frames; i++) {
+			dst[i*2]     = s16(left[i]);
+			dst[i*2 + 1] = right ? s16(right[i]) : 0;
+		}
+	}
+
+	/**
+	 * Mix S16 stereo frames into one float channel
+	 */
+	static void s16_stereo_to_float_mix(float *dst, int16_t const *src,
+	                                    unsigned frames)
+	{
+		for (unsigned i = 0; i < frames; i++)
+			dst[i] = float(int32_t(src[i*2]) + src[i*2 + 1])*MIX_SCALE;
+	}
+
+	/**
+	 * Accumulate the samples of 'src' scaled by 'gain' into 'acc'
+	 *
+	 * The sum is not clamped, saturation happens on the conversion to S16.
+	 */
+	static void accumulate(float *acc, float const *src, float gain,
+	                       unsigned frames)
+	{
+		for (unsigned i = 0; i < frames; i++)
+			acc[i] += src[i]*gain;
+	}
+};
+
+
+/*
+ * Generic version using the vector extension of GCC, mainly useful for
+ * comparison on platforms without NEON
+ */
+struct Audio::Convert::Vector
+{
+	typedef float   V4f __attribute__((vector_size(16)));
+	typedef int32_t V4i __attribute__((vector_size(16)));
+
+	static V4f _load(float const *p)
+	{
+		V4f v;
+		Genode::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	static V4i _s16(V4f v)
+	{
+		V4f const hi = {  32767.0f,  32767.0f,  32767.0f,  32767.0f };
+		V4f const lo = { -32768.0f, -32768.0f, -32768.0f, -32768.0f };
+
+		v = v*S16_SCALE;
+		v = v > hi ? hi : v;
+		v = v < lo ? lo : v;
+
+		return __builtin_convertvector(v, V4i);
+	}
+
+	static void float_to_s16_stereo(int16_t *dst, float const *left,
+	                                float const *right, unsigned frames)
+	{
+		unsigned i = 0;
+
+		for (; i + 4 <= frames; i += 4) {
+			V4i const l = _s16(_load(left + i));
+			V4i const r = right ? _s16(_load(right + i)) : V4i { };
+
+			for (unsigned j = 0; j < 4; j++) {
+				dst[(i + j)*2]     = int16_t(l[j]);
+				dst[(i + j)*2 + 1] = int16_t(r[j]);
+			}
+		}
+
+		Scalar::float_to_s16_stereo(dst + i*2, left + i, right ? right + i : nullptr,
+		                            frames - i);
+	}
+
+	static void s16_stereo_to_float_mix(float *dst, int16_t const *src,
+	                                    unsigned frames)
+	{
+		unsigned i = 0;
+
+		for (; i + 4 <= frames; i += 4) {
+			int16_t const *s = src + i*2;
+
+			V4i const sum = { s[0] + s[1], s[2] + s[3], s[4] + s[5], s[6] + s[7] };
+			V4f const f   = __builtin_convertvector(sum, V4f)*MIX_SCALE;
+
+			Genode::memcpy(dst + i, &f, sizeof(f));
+		}
+
+		Scalar::s16_stereo_to_float_mix(dst + i, src + i*2, frames - i);
+	}
+
+	static void accumulate(float *acc, float const *src, float gain,
+	                       unsigned frames)
+	{
+		unsigned i = 0;
+
+		for (; i + 4 <= frames; i += 4) {
+			V4f const f = _load(acc + i) + _load(src + i)*gain;
+			Genode::memcpy(acc + i, &f, sizeof(f));
+		}
+
+		Scalar::accumulate(acc + i, src + i, gain, frames - i);
+	}
+};
+
+
+#if defined(__ARM_NEON)
+
+struct Audio::Convert::Neon
+{
+	/* 'vcvtq' truncates and saturates, 'vqmovn' saturates to S16 */
+	static int16x8_t _s16(float const *p)
+	{
+		float32x4_t const lo = vmulq_n_f32(vld1q_f32(p),     S16_SCALE);
+		float32x4_t const hi = vmulq_n_f32(vld1q_f32(p + 4), S16_SCALE);
+
+		return vcombine_s16(vqmovn_s32(vcvtq_s32_f32(lo)),
+		                    vqmovn_s32(vcvtq_s32_f32(hi)));
+	}
+
+	static void float_to_s16_stereo(int16_t *dst, float const *left,
+	                                float const *right, unsigned frames)
+	{
+		unsigned i = 0;
+
+		for (; i + 8 <= frames; i += 8) {
+			int16x8x2_t const frame { { _s16(left + i),
+			                            right ? _s16(right + i) : vdupq_n_s16(0) } };
+			vst2q_s16(dst + i*2, frame);
+		}
+
+		Scalar::float_to_s16_stereo(dst + i*2, left + i, right ? right + i : nullptr,
+		                            frames - i);
+	}
+
+	static void s16_stereo_to_float_mix(float *dst, int16_t const *src,
+	                                    unsigned frames)
+	{
+		unsigned i = 0;
+
+		for (; i + 8 <= frames; i += 8) {
+			int16x8x2_t const frame = vld2q_s16(src + i*2);
+
+			int32x4_t const lo = vaddl_s16(vget_low_s16(frame.val[0]),
+			                               vget_low_s16(frame.val[1]));
+			int32x4_t const hi = vaddl_s16(vget_high_s16(frame.val[0]),
+			                               vget_high_s16(frame.val[1]));
+
+			vst1q_f32(dst + i,     vmulq_n_f32(vcvtq_f32_s32(lo), MIX_SCALE));
+			vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(hi), MIX_SCALE));
+		}
+
+		Scalar::s16_stereo_to_float_mix(dst + i, src + i*2, frames - i);
+	}
+
+	static void accumulate(float *acc, float const *src, float gain,
+	                       unsigned frames)
+	{
+		unsigned i = 0;
+
+		for (; i + 8 <= frames; i += 8) {
+			vst1q_f32(acc + i,     vmlaq_n_f32(vld1q_f32(acc + i),
+			                                   vld1q_f32(src + i),     gain));
+			vst1q_f32(acc + i + 4, vmlaq_n_f32(vld1q_f32(acc + i + 4),
+			                                   vld1q_f32(src + i + 4), gain));
+		}
+
+		Scalar::accumulate(acc + i, src + i, gain, frames - i);
+	}
+};
+
+namespace Audio { namespace Convert { using Best = Neon; } }
+
+#else
+
+namespace Audio { namespace Convert { using Best = Vector; } }
+
+#endif /* __ARM_NEON */
+
+
+namespace Audio { namespace Convert {
+
+	static inline void float_to_s16_stereo(int16_t *dst, float const *left,
+	                                       float const *right, unsigned frames)
+	{
+		Best::float_to_s16_stereo(dst, left, right, frames);
+	}
+
+	static inline void s16_stereo_to_float_mix(float *dst, int16_t const *src,
+	                                           unsigned frames)
+	{
+		Best::s16_stereo_to_float_mix(dst, src, frames);
+	}
+
+	static inline void accumulate(float *acc, float const *src, float gain,
+	                              unsigned frames)
+	{
+		Best::accumulate(acc, src, gain, frames);
+	}
+} }
+
+#endif /* _CONVERT_H_ */
@@ -12,10 +12,13 @@
  */
 
 #include <cpu/cache.h>
+#include <base/attached_rom_dataspace.h>
 #include <base/component.h>
 #include <base/heap.h>
+#include <os/reporter.h>
 #include <platform_session/device.h>
 #include <platform_session/dma_buffer.h>
+#include <timer_session/connection.h>
 #include <util/touch.h>
 
 #include <session.h>
@@ -27,6 +30,8 @@ namespace Audio {
 	struct I2s_dma;
 	class I2s;
 	class Dma_engine;
+	class Dma_clock;
+	class Ring_monitor;
 }
 
 
@@ -158,7 +163,25 @@ class Audio::I2s : Platform::Device::Mmio<0x30>
 			return underrun;
 		}
 
-		void enable() { write<Ap_control::Gen>(1); }
+		void enable()  { write<Ap_control::Gen>(1); }
+		void disable() { write<Ap_control::Gen>(0); }
+
+		void tx_enable(bool enable)
+		{
+			/* flush the FIFO before enabling it */
+			if (enable && !read<Ap_control::Txen>())
+				write<Ap_fifo::Ftx>(1);
+
+			write<Ap_control::Txen>(enable);
+		}
+
+		void rx_enable(bool enable)
+		{
+			if (enable && !read<Ap_control::Rxen>())
+				write<Ap_fifo::Frx>(1);
+
+			write<Ap_control::Rxen>(enable);
+		}
 };
 
 
@@ -391,6 +414,8 @@ class Audio::Dma_engine : Platform::Device::Mmio<0x34>
 
 				template <typename FUNC>
 				void head(FUNC const &func) { _queue.head(func); }
+
+				void flush() { _queue.dequeue_all([] (Descriptor &) { }); }
 		};
 
 	private:
@@ -416,12 +441,332 @@ class Audio::Dma_engine : Platform::Device::Mmio<0x34>
 };
 
 
+/*
+ * Sample clock derived from the position of a DMA channel
+ *
+ * The position within the cyclic ring of descriptors is sampled together
+ * with the current time whenever a descriptor is completed. The sample rate
+ * is measured over windows of a few seconds and smoothed, so that the
+ * latency of the interrupt handling cancels out.
+ */
+class Audio::Dma_clock
+{
+	private:
+
+		enum { BYTES_PER_FRAME = 4 };
+
+		enum : uint64_t { WINDOW_US = 2*1000*1000 };
+
+		/* tolerated deviation from the nominal rate, in percent */
+		enum { PLAUSIBLE_PERCENT = 5 };
+
+		/* bytes transferred before the ring was restarted */
+		uint64_t _base_bytes { 0 };
+
+		/* bytes transferred since the restart as of the last update */
+		uint64_t _bytes   { 0 };
+		bool     _updated { false };
+
+		bool     _ref_valid  { false };
+		uint64_t _ref_us     { 0 };
+		uint64_t _ref_frames { 0 };
+
+		Session::Clock _clock { };
+
+		void _measure(uint64_t frames, uint64_t now_us)
+		{
+			if (!_ref_valid || now_us < _ref_us || frames < _ref_frames) {
+				_ref_valid  = true;
+				_ref_us     = now_us;
+				_ref_frames = frames;
+				return;
+			}
+
+			uint64_t const elapsed_us = now_us - _ref_us;
+			if (elapsed_us < WINDOW_US)
+				return;
+
+			uint64_t const measured_mhz =
+				(frames - _ref_frames)*1000*1000*1000/elapsed_us;
+
+			uint64_t const nominal   = Session::Clock::NOMINAL_RATE_MHZ;
+			uint64_t const tolerance = nominal*PLAUSIBLE_PERCENT/100;
+
+			/* skip windows disturbed by a stalled DMA channel */
+			if (measured_mhz > nominal - tolerance && measured_mhz < nominal + tolerance)
+				_clock.rate_mhz = (_clock.rate_mhz*7 + measured_mhz)/8;
+
+			_ref_us     = now_us;
+			_ref_frames = frames;
+		}
+
+	public:
+
+		/**
+		 * Update the position
+		 *
+		 * \param index   descriptor currently processed by the channel
+		 * \param offset  bytes of the descriptor already transferred
+		 */
+		void update(unsigned index, size_t offset, unsigned count,
+		            size_t period, uint64_t now_us)
+		{
+			uint64_t const ring_bytes = uint64_t(count)*period;
+			uint64_t const ring_pos   = uint64_t(index)*period + offset;
+
+			if (!ring_bytes)
+				return;
+
+			/*
+			 * Interrupts of descriptors completed while the interrupt of
+			 * a previous one was still pending are coalesced. So neither
+			 * the interrupts nor the descriptor index tell whether the
+			 * channel wrapped around the ring more than once. The lap is
+			 * chosen such that the position is closest to the one
+			 * expected after the time elapsed since the last update.
+			 */
+			uint64_t const elapsed_us =
+				(_updated && now_us > _clock.time_us) ? now_us - _clock.time_us : 0;
+
+			uint64_t const expected = _bytes
+				+ elapsed_us*_clock.rate_mhz*BYTES_PER_FRAME/(1000ull*1000*1000);
+
+			uint64_t const lap = expected/ring_bytes;
+
+			uint64_t bytes = (lap + 1)*ring_bytes + ring_pos;
+			for (uint64_t l = lap ? lap - 1 : 0; l <= lap; l++) {
+
+				uint64_t const candidate = l*ring_bytes + ring_pos;
+
+				/* the position never moves backwards */
+				if (candidate < _bytes)
+					continue;
+
+				auto distance = [&] (uint64_t pos) {
+					return pos > expected ? pos - expected : expected - pos; };
+
+				if (distance(candidate) < distance(bytes))
+					bytes = candidate;
+			}
+
+			_bytes   = bytes;
+			_updated = true;
+
+			uint64_t const frames = (_base_bytes + _bytes)/BYTES_PER_FRAME;
+
+			_measure(frames, now_us);
+
+			_clock.frames  = frames;
+			_clock.time_us = now_us;
+		}
+
+		/**
+		 * Continue counting after the ring was restarted with its first
+		 * descriptor
+		 */
+		void restart()
+		{
+			_base_bytes = _clock.frames*BYTES_PER_FRAME;
+			_bytes      = 0;
+			_updated    = false;
+			_ref_valid  = false;
+		}
+
+		Session::Clock const &clock() const { return _clock; }
+};
+
+
+/*
+ * Monitor of the timing of a DMA ring
+ *
+ * The monitor counts the xruns reported by the audio interface and the
+ * completion interrupts handled later than expected. An interrupt is late
+ * if more than one and a half periods passed since the previous one. If the
+ * delay even exceeds the periods covered by the ring, samples were lost or
+ * repeated, which is counted like an xrun. In adaptive mode, the monitor
+ * advises to grow the ring after repeated xruns and to shrink it again
+ * after a quiet period.
+ */
+class Audio::Ring_monitor
+{
+	public:
+
+		struct Config
+		{
+			bool     adaptive;
+			unsigned xruns;      /* xruns within the window to grow the ring */
+			uint64_t window_us;
+			uint64_t quiet_us;   /* time without xrun to shrink the ring */
+
+			static Config from_node(Node const &node)
+			{
+				return {
+					.adaptive  = node.attribute_value("adaptive", false),
+					.xruns     = max(node.attribute_value("adaptive_xruns", 3U), 1U),
+					.window_us = 1000*node.attribute_value("adaptive_window_ms",  2000UL),
+					.quiet_us  = 1000*node.attribute_value("adaptive_quiet_ms",  60000UL),
+				};
+			}
+		};
+
+		struct Stats
+		{
+			uint64_t xruns;
+			uint64_t late;
+			uint64_t lost;
+		};
+
+		enum class Advice { KEEP, GROW, SHRINK };
+
+	private:
+
+		enum { BYTES_PER_FRAME = 4 };
+
+		Config const &_config;
+
+		uint64_t const _period_us;
+
+		bool     _irq_valid { false };
+		uint64_t _irq_us    { 0 };
+
+		uint64_t _window_start_us { 0 };
+		unsigned _window_xruns    { 0 };
+		uint64_t _last_xrun_us    { 0 };
+
+		Stats _stats { };
+
+		void _xrun(uint64_t now_us)
+		{
+			if (now_us - _window_start_us > _config.window_us) {
+				_window_start_us = now_us;
+				_window_xruns    = 0;
+			}
+
+			_window_xruns++;
+			_last_xrun_us = now_us;
+		}
+
+	public:
+
+		Ring_monitor(Config const &config, size_t period_bytes)
+		:
+			_config(config),
+			_period_us(period_bytes/BYTES_PER_FRAME*1000*1000*1000
+			           /Session::Clock::NOMINAL_RATE_MHZ)
+		{ }
+
+		/**
+		 * Account a completion interrupt of a ring with 'count' descriptors
+		 */
+		void irq(unsigned count, uint64_t now_us)
+		{
+			if (_irq_valid && now_us > _irq_us) {
+				uint64_t const elapsed_us = now_us - _irq_us;
+
+				if (elapsed_us > _period_us*3/2)
+					_stats.late++;
+
+				if (elapsed_us > _period_us*count + _period_us/2) {
+					_stats.lost++;
+					_xrun(now_us);
+				}
+			}
+
+			_irq_valid = true;
+			_irq_us    = now_us;
+		}
+
+		/**
+		 * Account an xrun reported by the audio interface
+		 */
+		void xrun(uint64_t now_us)
+		{
+			_stats.xruns++;
+			_xrun(now_us);
+		}
+
+		/**
+		 * Forget the time of the last interrupt after the ring was restarted
+		 */
+		void restart() { _irq_valid = false; }
+
+		Advice advice(unsigned count, unsigned min_count, unsigned max_count,
+		              uint64_t now_us)
+		{
+			if (!_config.adaptive)
+				return Advice::KEEP;
+
+			if (_window_xruns >= _config.xruns && count < max_count) {
+				_window_xruns = 0;
+				_last_xrun_us = now_us;
+				return Advice::GROW;
+			}
+
+			if (now_us - _last_xrun_us >= _config.quiet_us && count > min_count) {
+				_last_xrun_us = now_us;
+				return Advice::SHRINK;
+			}
+
+			return Advice::KEEP;
+		}
+
+		Stats const &stats() const { return _stats; }
+};
+
+
 struct Audio::Main
 {
 	Env &_env;
 
+	Attached_rom_dataspace _config_rom { _env, "config" };
+
+	bool const _verbose { _config_rom.node().attribute_value("verbose", false) };
+
+	/*
+	 * Depth of the DMA rings and size of each descriptor
+	 *
+	 * The DMA interrupt fires once per descriptor, so the period size
+	 * determines the interrupt rate and, together with the number of
+	 * descriptors, the latency.
+	 */
+	struct Ring_config
+	{
+		enum { MIN_DESCRIPTORS = 2, MAX_DESCRIPTORS = 32 };
+
+		/* multiple of the DMA burst of eight 32-bit words */
+		enum { PERIOD_ALIGN = 32, MIN_PERIOD = 128, MAX_PERIOD = 0x10000 };
+
+		unsigned tx_descriptors;
+		unsigned rx_descriptors;
+		size_t   period_bytes;
+
+		static unsigned _descriptors(Node const &node, char const *attr)
+		{
+			return max(min(node.attribute_value(attr, unsigned(MIN_DESCRIPTORS)),
+			               unsigned(MAX_DESCRIPTORS)),
+			           unsigned(MIN_DESCRIPTORS));
+		}
+
+		static Ring_config from_node(Node const &node)
+		{
+			size_t const period =
+				node.attribute_value("period_bytes", Session::Packet().size);
+
+			return {
+				.tx_descriptors = _descriptors(node, "tx_descriptors"),
+				.rx_descriptors = _descriptors(node, "rx_descriptors"),
+				.period_bytes   = max(min(period, size_t(MAX_PERIOD)),
+				                      size_t(MIN_PERIOD)) & ~size_t(PERIOD_ALIGN - 1),
+			};
+		}
+	};
+
+	Ring_config const _ring { Ring_config::from_node(_config_rom.node()) };
+
 	Platform::Connection _platform { _env };
 
+	Timer::Connection _timer { _env };
+
 	Heap            _heap    { _env.ram(), _env.rm() };
 	Audio::Session &_session { Session::construct(_env, _heap) };
 
@@ -443,51 +788,167 @@ struct Audio::Main
 	Dma_engine::Channel &_tx { _dma.channel(0) };
 	Dma_engine::Channel &_rx { _dma.channel(1) };
 
-	enum { TX = 2 };
-	Constructible<Dma_engine::Descriptor> _tx_descr[TX];
+	unsigned _tx_count { _ring.tx_descriptors };
+	unsigned _tx_max   { Ring_config::MAX_DESCRIPTORS };
+	Constructible<Dma_engine::Descriptor> _tx_descr[Ring_config::MAX_DESCRIPTORS];
 
-	enum { RX = 2 };
-	Constructible<Dma_engine::Descriptor> _rx_descr[RX];
+	unsigned _rx_count { _ring.rx_descriptors };
+	unsigned _rx_max   { Ring_config::MAX_DESCRIPTORS };
+	Constructible<Dma_engine::Descriptor> _rx_descr[Ring_config::MAX_DESCRIPTORS];
 
-	Main(Env &env) : _env(env)
+	/*
+	 * Captured samples are handed to the session in packets of one
+	 * 'Audio_in::PERIOD'. If the period size of the descriptors differs,
+	 * the samples are joined or split.
+	 */
+	int16_t _record_data[Audio_out::PERIOD*2] { };
+	size_t  _record_used { 0 };
+
+	Dma_clock _rx_clock { };
+
+	Ring_monitor::Config const _monitor_config {
+		Ring_monitor::Config::from_node(_config_rom.node()) };
+
+	Ring_monitor _tx_monitor { _monitor_config, _ring.period_bytes };
+	Ring_monitor _rx_monitor { _monitor_config, _ring.period_bytes };
+
+	/*
+	 * Periods for which the client ran out of samples while playing,
+	 * in contrast to xruns, which are caused by the driver
+	 */
+	uint64_t _tx_starved { 0 };
+	bool     _tx_playing { false };
+
+	/*
+	 * The channels are stopped after being idle for 'idle_ms', i.e., no
+	 * samples were played or no client consumed the captured samples. The
+	 * session wakes up the driver as soon as a client becomes active.
+	 */
+	size_t const _idle_bytes {
+		_config_rom.node().attribute_value("idle_ms", 1000UL)
+		*(Session::Clock::NOMINAL_RATE_MHZ/1000)/1000*4 };
+
+	bool _tx_running { false };
+	bool _rx_running { false };
+
+	size_t _tx_idle_bytes { 0 };
+	size_t _rx_idle_bytes { 0 };
+
+	uint64_t _tx_stops { 0 };
+	uint64_t _rx_stops { 0 };
+
+	Signal_handler<Main> _wakeup_handler {
+		_env.ep(), *this, &Main::_handle_wakeup };
+
+	void _handle_wakeup()
 	{
-		_irq_audio.sigh(_irq_handler_audio);
-		_irq_audio.ack();
+		if (!_tx_running)
+			_start_tx();
 
-		/* setup tx channel */
-		for (unsigned i = 0; i < TX; i++)
-			_tx_descr[i].construct(_platform, Session::Packet().size);
+		if (!_rx_running && _session.capture_wanted())
+			_start_rx();
+	}
 
-		for (unsigned i = 0; i < TX; i++) {
-			/* cyclic descriptors (last points to first) */
-			setup_tx_descriptor(*_tx_descr[i], _tx_descr[(i + 1) % TX]->dma_addr());
-		}
+	static bool _contains(Dma_engine::Descriptor const &descr, addr_t cur)
+	{
+		addr_t const data = descr.data_dma_addr();
+		return cur >= data && cur < data + descr.length();
+	}
 
-		_tx.descr_dma(_tx_descr[0]->dma_addr());
-		_tx.irq_enable(Dma_engine::Channel::FULL_PACKET);
+	void _update_rx_clock()
+	{
+		addr_t const cur = _rx.cur_dest();
 
-		/* setup rx channel */
-		for (unsigned i = 0; i < RX; i++)
-			_rx_descr[i].construct(_platform, Session::Packet().size);
+		for (unsigned i = 0; i < _rx_count; i++) {
+			if (!_contains(*_rx_descr[i], cur))
+				continue;
 
-		for (unsigned i = 0; i < RX; i++) {
-			/* cyclic descriptors (last points to first) */
-			setup_rx_descriptor(*_rx_descr[i], _rx_descr[(i + 1) % RX]->dma_addr());
-			_rx.enqueue(*_rx_descr[i]);
+			size_t const len  = _rx_descr[i]->length();
+			size_t const left = min(size_t(_rx.bcnt_left()), len);
+			_rx_clock.update(i, len - left, _rx_count, len, _timer.elapsed_us());
+			return;
 		}
+	}
 
-		_rx.descr_dma(_rx_descr[0]->dma_addr());
+	/*
+	 * Periodic report of xruns and ring state, disabled by default
+	 */
+	uint64_t const _report_period_ms {
+		_config_rom.node().attribute_value("report_period_ms", 0UL) };
+
+	Constructible<Timer::Periodic_timeout<Main>> _report_timeout { };
+	Constructible<Expanding_reporter>            _stats_reporter { };
+
+	void _handle_report(Duration)
+	{
+		_stats_reporter->generate([&] (Generator &g) {
+
+			Ring_monitor::Stats const &tx = _tx_monitor.stats();
+			g.node("tx", [&] {
+				g.attribute("descriptors",  _tx_count);
+				g.attribute("configured",   _ring.tx_descriptors);
+				g.attribute("period_bytes", _ring.period_bytes);
+				g.attribute("underruns",    tx.xruns);
+				g.attribute("late",         tx.late);
+				g.attribute("lost",         tx.lost);
+				g.attribute("starved",      _tx_starved);
+				g.attribute("running",      _tx_running);
+				g.attribute("stops",        _tx_stops);
+			});
+
+			Ring_monitor::Stats const &rx = _rx_monitor.stats();
+			g.node("rx", [&] {
+				g.attribute("descriptors",  _rx_count);
+				g.attribute("configured",   _ring.rx_descriptors);
+				g.attribute("period_bytes", _ring.period_bytes);
+				g.attribute("overruns",     rx.xruns);
+				g.attribute("late",         rx.late);
+				g.attribute("lost",         rx.lost);
+				g.attribute("running",      _rx_running);
+				g.attribute("stops",        _rx_stops);
+			});
+
+			Session::Clock const &clock = _rx_clock.clock();
+			g.node("clock", [&] {
+				g.attribute("rate_mhz",  clock.rate_mhz);
+				g.attribute("drift_ppm", clock.drift_ppm());
+			});
+
+			_session.generate_report(g);
+		});
+	}
+
+	Main(Env &env) : _env(env)
+	{
+		if (_verbose)
+			log("DMA rings: ", _tx_count, " TX and ", _rx_count, " RX descriptors of ",
+			    _ring.period_bytes, " bytes");
+
+		_irq_audio.sigh(_irq_handler_audio);
+		_irq_audio.ack();
+
+		for (unsigned i = 0; i < _tx_count; i++)
+			_tx_descr[i].construct(_platform, _ring.period_bytes);
+
+		for (unsigned i = 0; i < _rx_count; i++)
+			_rx_descr[i].construct(_platform, _ring.period_bytes);
+
+		_tx.irq_enable(Dma_engine::Channel::FULL_PACKET);
 		_rx.irq_enable(Dma_engine::Channel::FULL_PACKET);
 
 		_irq_dma.sigh(_irq_handler_dma);
 		_irq_dma.ack();
 
-		tx();
+		_session.wakeup_sigh(_wakeup_handler);
 
-		_tx.enable();
-		_rx.enable();
+		_start_tx();
+		_start_rx();
 
-		_i2s.enable();
+		if (_report_period_ms) {
+			_stats_reporter.construct(_env, "audio_stats", "audio_stats");
+			_report_timeout.construct(_timer, *this, &Main::_handle_report,
+			                          Microseconds { 1000*_report_period_ms });
+		}
 	}
 
 	void setup_tx_descriptor(Dma_engine::Descriptor &descr, addr_t const dma_addr_next)
@@ -512,83 +973,355 @@ struct Audio::Main
 		descr.dma_next(dma_addr_next);
 	}
 
-	void fill(addr_t buffer)
+	/*
+	 * Start a stopped channel
+	 *
+	 * The DMA channel is enabled before the FIFO of the audio interface,
+	 * so that the FIFO is fed as soon as it requests data.
+	 */
+	void _start_tx()
+	{
+		using Descriptor = Dma_engine::Descriptor;
+
+		for (unsigned i = 0; i < _tx_count; i++) {
+			/* cyclic descriptors (last points to first) */
+			setup_tx_descriptor(*_tx_descr[i], _tx_descr[(i + 1) % _tx_count]->dma_addr());
+		}
+
+		/*
+		 * Prime the ring with the samples available. Descriptors left
+		 * silent are played first, so that the samples submitted by the
+		 * client later on continue seamlessly in the descriptors refilled
+		 * after them.
+		 */
+		unsigned first = 0;
+		bool     more  = true;
+		for (unsigned i = 0; i < _tx_count; i++) {
+			Descriptor &descr = *_tx_descr[i];
+
+			if (!more) {
+				bzero((void *)descr.data(), descr.length());
+				continue;
+			}
+
+			size_t const n = fill(descr.data(), descr.length());
+
+			more = (n == descr.length());
+			if (n) first = (i + 1) % _tx_count;
+		}
+
+		/* the descriptors are refilled in the order played */
+		for (unsigned i = 0; i < _tx_count; i++)
+			_tx.enqueue(*_tx_descr[(first + i) % _tx_count]);
+
+		_tx.descr_dma(_tx_descr[first]->dma_addr());
+		_tx.enable();
+
+		_i2s.tx_enable(true);
+		_i2s.enable();
+
+		/* discard an underrun caused while the channel was stopped */
+		_i2s.tx_underrun();
+
+		_tx_running    = true;
+		_tx_idle_bytes = 0;
+		_tx_monitor.restart();
+	}
+
+	void _start_rx()
 	{
-		Session::Packet packet = _session.play_packet();
-		if (packet.valid())
-			memcpy((void *)buffer, packet.data, packet.size);
-		else
-			bzero((void *)buffer, packet.size);
+		for (unsigned i = 0; i < _rx_count; i++) {
+			/* cyclic descriptors (last points to first) */
+			setup_rx_descriptor(*_rx_descr[i], _rx_descr[(i + 1) % _rx_count]->dma_addr());
+			_rx.enqueue(*_rx_descr[i]);
+		}
+
+		_rx.descr_dma(_rx_descr[0]->dma_addr());
+		_rx.enable();
+
+		_i2s.rx_enable(true);
+		_i2s.enable();
+
+		/* discard an overrun caused while the channel was stopped */
+		_i2s.rx_overrun();
+
+		_rx_running    = true;
+		_rx_idle_bytes = 0;
+		_rx_clock.restart();
+		_rx_monitor.restart();
 	}
 
-	void tx()
+	void _stop_tx()
 	{
-		if (_tx.empty()) {
-			fill(_tx_descr[0]->data());
-			/*
-			 * Store in reverse so that the last descr is used first
-			 * as the first one is currently played.
-			 */
-			for (int i = TX - 1; i >= 0; i--) {
-				_tx.enqueue(*_tx_descr[i]);
+		_tx.disable();
+		_tx.flush();
+		_i2s.tx_enable(false);
+
+		_tx_running = false;
+		_tx_playing = false;
+
+		if (!_rx_running)
+			_i2s.disable();
+	}
+
+	void _stop_rx()
+	{
+		_rx.disable();
+		_rx.flush();
+		_i2s.rx_enable(false);
+
+		_rx_running  = false;
+		_record_used = 0;
+
+		if (!_tx_running)
+			_i2s.disable();
+	}
+
+	/*
+	 * Construct the descriptors from 'from' up to 'to'
+	 *
+	 * \return false if the DMA memory could not be allocated
+	 */
+	bool _construct(Constructible<Dma_engine::Descriptor> descr[],
+	                unsigned from, unsigned to)
+	{
+		auto destruct = [&] (unsigned i) {
+			for (unsigned j = from; j < i; j++)
+				descr[j].destruct(); };
+
+		for (unsigned i = from; i < to; i++) {
+			try { descr[i].construct(_platform, _ring.period_bytes); }
+			catch (Out_of_ram)  { destruct(i); return false; }
+			catch (Out_of_caps) { destruct(i); return false; }
+		}
+		return true;
+	}
+
+	/*
+	 * Change the depth of a ring at runtime
+	 *
+	 * The channel is stopped and restarted with the first descriptor.
+	 * Samples pending in the ring are dropped, which results in a short gap.
+	 */
+	void _resize_tx(unsigned count)
+	{
+		if (count > _tx_count && !_construct(_tx_descr, _tx_count, count)) {
+			warning("unable to grow TX ring, DMA memory exhausted");
+			_tx_max = _tx_count;
+			return;
+		}
+
+		_stop_tx();
+
+		for (unsigned i = count; i < _tx_count; i++)
+			_tx_descr[i].destruct();
+
+		_tx_count = count;
+		_start_tx();
+
+		if (_verbose)
+			log("TX ring resized to ", _tx_count, " descriptors");
+	}
+
+	void _resize_rx(unsigned count)
+	{
+		if (count > _rx_count && !_construct(_rx_descr, _rx_count, count)) {
+			warning("unable to grow RX ring, DMA memory exhausted");
+			_rx_max = _rx_count;
+			return;
+		}
+
+		_stop_rx();
+
+		for (unsigned i = count; i < _rx_count; i++)
+			_rx_descr[i].destruct();
+
+		_rx_count = count;
+		_start_rx();
+
+		if (_verbose)
+			log("RX ring resized to ", _rx_count, " descriptors");
+	}
+
+	void _adapt(uint64_t now_us)
+	{
+		using Advice = Ring_monitor::Advice;
+
+		if (_tx_running) {
+			switch (_tx_monitor.advice(_tx_count, _ring.tx_descriptors, _tx_max, now_us)) {
+			case Advice::GROW:   _resize_tx(_tx_count + 1); break;
+			case Advice::SHRINK: _resize_tx(_tx_count - 1); break;
+			case Advice::KEEP:   break;
 			}
+		}
+
+		if (_rx_running) {
+			switch (_rx_monitor.advice(_rx_count, _ring.rx_descriptors, _rx_max, now_us)) {
+			case Advice::GROW:   _resize_rx(_rx_count + 1); break;
+			case Advice::SHRINK: _resize_rx(_rx_count - 1); break;
+			case Advice::KEEP:   break;
+			}
+		}
+	}
+
+	/*
+	 * Stop a channel once the whole ring has been idle for long enough
+	 */
+	void _stop_idle()
+	{
+		if (!_idle_bytes)
 			return;
+
+		if (_tx_running
+		 && _tx_idle_bytes >= max(_idle_bytes, _tx_count*_ring.period_bytes)) {
+			_stop_tx();
+			_tx_stops++;
 		}
 
-		auto apply = [&](Dma_engine::Descriptor &descr)
-		{
-			fill(descr.data());
-			_tx.enqueue(descr);
-		};
+		if (_rx_running
+		 && _rx_idle_bytes >= max(_idle_bytes, _rx_count*_ring.period_bytes)) {
+			_stop_rx();
+			_rx_stops++;
+		}
+	}
 
-		_tx.dequeue(apply);
+	void _poll_xruns(uint64_t now_us)
+	{
+		if (_i2s.tx_underrun())
+			_tx_monitor.xrun(now_us);
+
+		if (_i2s.rx_overrun())
+			_rx_monitor.xrun(now_us);
 	}
 
-	void rx()
+	/**
+	 * Fill the DMA buffer with samples of the session
+	 *
+	 * \return number of bytes played, the remainder is silence
+	 */
+	size_t fill(addr_t buffer, size_t size)
 	{
-		auto apply = [&](Dma_engine::Descriptor &descr)
-		{
-			Audio::Session::Packet packet { (int16_t *)descr.data(),
-				descr.length() };
-			_session.record_packet(packet);
-			_rx.enqueue(descr);
-		};
+		/* the session converts the samples directly into DMA memory */
+		size_t const n = min(_session.play({ (int16_t *)buffer, size }), size);
+
+		/* the client did not keep up after having played a full period */
+		if (n < size && _tx_playing)
+			_tx_starved++;
+
+		_tx_playing    = (n == size);
+		_tx_idle_bytes = n ? 0 : _tx_idle_bytes + size;
 
-		_rx.dequeue(apply);
+		/* no data available, play silence for the remaining period */
+		if (n < size)
+			bzero((void *)(buffer + n), size - n);
+
+		return n;
 	}
 
-	void handle_dma_irq()
+	void record(addr_t buffer, size_t size)
 	{
-		if (_tx.irq_pending(Dma_engine::Channel::FULL_PACKET))
+		size_t const packet_size = sizeof(_record_data);
 
-			/*
-			 * This check is only necessary to cover any spurious
-			 * interrupt that might occur.
-			 */
+		/* hand out descriptors matching the packet size directly */
+		if (!_record_used && size == packet_size) {
+			_session.record_packet({ (int16_t *)buffer, size }, _rx_clock.clock());
+			return;
+		}
+
+		char const *src = (char const *)buffer;
+
+		while (size) {
+			size_t const n = min(size, packet_size - _record_used);
+			memcpy((char *)_record_data + _record_used, src, n);
+
+			src          += n;
+			size         -= n;
+			_record_used += n;
+
+			if (_record_used == packet_size) {
+				_session.record_packet({ _record_data, packet_size },
+				                       _rx_clock.clock());
+				_record_used = 0;
+			}
+		}
+	}
+
+	/*
+	 * Refill all descriptors completed since the last interrupt, which are
+	 * more than one if the interrupt was handled late. The check of the
+	 * head also covers any spurious interrupt.
+	 */
+	void tx()
+	{
+		for (unsigned i = 0; i + 1 < _tx_count; i++) {
+
+			bool busy = false;
 			_tx.head([&] (Dma_engine::Descriptor &descr) {
-				addr_t const cur = _tx.cur_src() & 0xfffff000u;
-				if (cur != descr.data_dma_addr())
-					tx();
+				busy = _contains(descr, _tx.cur_src()); });
+
+			if (busy)
+				return;
+
+			_tx.dequeue([&] (Dma_engine::Descriptor &descr) {
+				fill(descr.data(), descr.length());
+				_tx.enqueue(descr);
 			});
+		}
+	}
 
-		if (_rx.irq_pending(Dma_engine::Channel::FULL_PACKET))
+	void rx()
+	{
+		_update_rx_clock();
+
+		for (unsigned i = 0; i + 1 < _rx_count; i++) {
+
+			bool busy = false;
+			_rx.head([&] (Dma_engine::Descriptor &descr) {
+				busy = _contains(descr, _rx.cur_dest()); });
+
+			if (busy)
+				return;
+
+			_rx.dequeue([&] (Dma_engine::Descriptor &descr) {
+				_rx_idle_bytes = _session.capture_wanted()
+				               ? 0 : _rx_idle_bytes + descr.length();
+				record(descr.data(), descr.length());
+				_rx.enqueue(descr);
+			});
+		}
+	}
+
+	void handle_dma_irq()
+	{
+		uint64_t const now_us = _timer.elapsed_us();
+
+		_poll_xruns(now_us);
+
+		/* a stopped channel may have left a pending interrupt */
+		if (_tx.irq_pending(Dma_engine::Channel::FULL_PACKET) && _tx_running) {
+			_tx_monitor.irq(_tx_count, now_us);
+			tx();
+		}
+
+		if (_rx.irq_pending(Dma_engine::Channel::FULL_PACKET) && _rx_running) {
+			_rx_monitor.irq(_rx_count, now_us);
 			rx();
+		}
+
+		_adapt(now_us);
+		_stop_idle();
 
 		_irq_dma.ack();
 	}
 
 	/*
-	 * This is just for debugging, since we have two cyclic DMA descriptors, this
-	 * should not happen, it will only sound terrible ;)
+	 * The xrun interrupts are not enabled, the status is polled on each DMA
+	 * interrupt instead. Should the interrupt fire nevertheless, the xruns
+	 * are accounted as well.
 	 */
 	void handle_audio_irq()
 	{
-		if (_i2s.tx_underrun()) {
-			warning("TX underrun");
-		}
-		if (_i2s.rx_overrun()) {
-			warning("RX overrun");
-		}
+		_poll_xruns(_timer.elapsed_us());
 		_irq_audio.ack();
 	}
 };
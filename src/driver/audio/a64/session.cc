@@ -19,88 +19,289 @@
 #include <base/session_label.h>
 #include <base/component.h>
 #include <base/heap.h>
+#include <base/registry.h>
+#include <os/session_policy.h>
 #include <root/component.h>
 
+#include "convert.h"
 #include "session.h"
 
 using namespace Genode;
 
 namespace Audio_out {
 	class  Session_component;
-	class  Out;
+	class  Mixer;
 	class  Root;
 	struct Root_policy;
 	enum   Channel_number { LEFT, RIGHT, MAX_CHANNELS, INVALID = MAX_CHANNELS };
-	static Session_component *channel_acquired[MAX_CHANNELS];
+
+	/* the sessions of all channels are mixed */
+	enum { MAX_SESSIONS_PER_CHANNEL = 8 };
+
+	using Sessions = Registry<Session_component>;
+	static Sessions sessions;
 }
 
 /**************
  ** Playback **
  **************/
 
-class Audio_out::Session_component : public Audio_out::Session_rpc_object
+class Audio_out::Session_component : public  Audio_out::Session_rpc_object,
+                                     private Audio_out::Sessions::Element
 {
 	private:
 
-		Channel_number _channel;
+		Session_label  const _label;
+		Channel_number const _channel;
+
+		/* label shared by the channels of a stereo client */
+		Session_label  const _pair_label;
+
+		Signal_context_capability _data_avail;
+
+		/* volume in percent */
+		unsigned _volume;
+
+		/* packet currently mixed, a descriptor may cover only a part of it */
+		Packet   *_packet { nullptr };
+		unsigned  _frame  { 0 };
+
+		/* the client ran out of packets after having played */
+		bool     _playing   { false };
+		uint64_t _underruns { 0 };
+
+		void _finish_packet()
+		{
+			Packet *p = _packet;
+
+			_packet = nullptr;
+
+			p->invalidate();
+			p->mark_as_played();
+
+			bool const full = stream()->full();
+
+			stream()->pos(stream()->packet_position(p));
+			stream()->increment_position();
+
+			if (full)
+				alloc_submit();
+
+			/* always report when a period has passed */
+			progress_submit();
+		}
 
 	public:
 
-		Session_component(Genode::Env &env, Channel_number channel, Signal_context_capability cap)
+		Session_component(Genode::Env &env, Session_label const &label,
+		                  Channel_number channel, Session_label const &pair_label,
+		                  unsigned volume, Signal_context_capability cap)
 		:
-			Session_rpc_object(env, cap), _channel(channel)
+			Session_rpc_object(env, cap),
+			Sessions::Element(sessions, *this),
+			_label(label), _channel(channel), _pair_label(pair_label),
+			_data_avail(cap), _volume(volume)
+		{ }
+
+		/* packets may have been queued before starting */
+		void start() override
 		{
-			Audio_out::channel_acquired[_channel] = this;
+			Session_rpc_object::start();
+			Signal_transmitter(_data_avail).submit();
 		}
 
-		~Session_component()
+		Session_label const &label()      const { return _label; }
+		Channel_number       channel()    const { return _channel; }
+		Session_label const &pair_label() const { return _pair_label; }
+
+		void volume(unsigned volume) { _volume = volume; }
+
+		/**
+		 * Make the next packet of the session current
+		 *
+		 * \return false if the session has no packet to be played
+		 */
+		bool fetch()
 		{
-			Audio_out::channel_acquired[_channel] = 0;
+			if (!active()) {
+				_packet  = nullptr;
+				_playing = false;
+				return false;
+			}
+
+			if (_packet)
+				return true;
+
+			Packet *p = stream()->get(stream()->pos());
+			if (!p->valid())
+				return false;
+
+			_packet = p;
+			_frame  = 0;
+			return true;
+		}
+
+		/* frames left in the current packet */
+		unsigned frames_left() const { return Audio_out::PERIOD - _frame; }
+
+		/**
+		 * Accumulate 'frames' frames of the current packet into 'acc'
+		 */
+		void mix(float *acc, unsigned frames)
+		{
+			float const gain = float(_volume)/100;
+
+			Audio::Convert::accumulate(acc, _packet->content() + _frame,
+			                           gain, frames);
+
+			_frame += frames;
+
+			if (_frame == Audio_out::PERIOD)
+				_finish_packet();
+		}
+
+		/**
+		 * Account the frames played out of the requested frames
+		 */
+		void played(unsigned done, unsigned frames)
+		{
+			if (!active())
+				return;
+
+			if (done < frames && _playing)
+				_underruns++;
+
+			_playing = (done == frames);
+		}
+
+		void generate_report(Generator &g)
+		{
+			g.attribute("label",     _label.string());
+			g.attribute("channel",   _channel == LEFT ? "left" : "right");
+			g.attribute("volume",    _volume);
+			g.attribute("active",    active());
+			g.attribute("underrun",  active() && !_playing);
+			g.attribute("underruns", _underruns);
 		}
 };
 
 
-class Audio_out::Out
+/*
+ * Mixer of all sessions
+ *
+ * The samples of the sessions of each channel are accumulated with the
+ * volume of the session as gain, and saturated on the conversion to S16.
+ * The volume is assigned by the '<policy>' matching the session label.
+ *
+ * The left and right sessions of a stereo client, whose labels differ only
+ * in the channel name as last element, form a pair. A pair advances only
+ * while both sessions have a packet, which keeps the channels in lockstep
+ * if one of them underruns.
+ */
+class Audio_out::Mixer
 {
 	private:
 
-		Genode::Env                            &_env;
-		Genode::Signal_handler<Audio_out::Out>  _data_avail_dispatcher;
+		Genode::Env &_env;
+
+		Genode::Signal_handler<Mixer> _data_avail_dispatcher {
+			_env.ep(), *this, &Mixer::_handle_data_avail };
 
-		Stream *left()  { return channel_acquired[LEFT]->stream(); }
-		Stream *right() { return channel_acquired[RIGHT]->stream(); }
+		Signal_context_capability _wakeup { };
 
-		void _advance_position(Packet *l, Packet *r)
+		/* a client submitted a packet to its empty stream */
+		void _handle_data_avail()
 		{
-			bool full_left = left()->full();
-			bool full_right = right()->full();
+			if (_wakeup.valid())
+				Signal_transmitter(_wakeup).submit();
+		}
 
-			left()->pos(left()->packet_position(l));
-			right()->pos(right()->packet_position(r));
+		Attached_rom_dataspace _config { _env, "config" };
 
-			left()->increment_position();
-			right()->increment_position();
+		Genode::Signal_handler<Mixer> _config_handler {
+			_env.ep(), *this, &Mixer::_handle_config };
 
-			Session_component *channel_left  = channel_acquired[LEFT];
-			Session_component *channel_right = channel_acquired[RIGHT];
+		void _handle_config()
+		{
+			_config.update();
 
-			if (full_left)
-				channel_left->alloc_submit();
+			sessions.for_each([&] (Session_component &session) {
+				session.volume(volume(session.label())); });
+		}
 
-			if (full_right)
-				channel_right->alloc_submit();
+		float _acc[MAX_CHANNELS][Audio_out::PERIOD] { };
+
+		/*
+		 * Sessions to be mixed, collected for each period as the pairing
+		 * iterates over the sessions in a nested fashion
+		 */
+		Session_component *_active[MAX_CHANNELS*MAX_SESSIONS_PER_CHANNEL] { };
+		unsigned           _num_active { 0 };
+
+		Session_component *_first(Channel_number channel,
+		                          Session_label const &pair_label) const
+		{
+			for (unsigned i = 0; i < _num_active; i++)
+				if (_active[i]->channel() == channel
+				 && _active[i]->pair_label() == pair_label)
+					return _active[i];
+			return nullptr;
+		}
+
+		/*
+		 * Only the first left and the first right session with the same
+		 * pair label form a pair
+		 */
+		Session_component *_partner(Session_component const &session) const
+		{
+			Channel_number const other = session.channel() == LEFT ? RIGHT : LEFT;
+
+			if (_first(session.channel(), session.pair_label()) != &session)
+				return nullptr;
+
+			return _first(other, session.pair_label());
 		}
 
-		void _handle_data_avail() { }
+		/**
+		 * Accumulate up to 'frames' frames of a session or a pair
+		 *
+		 * \return number of frames accumulated
+		 */
+		unsigned _mix(Session_component &first, Session_component *second,
+		              unsigned frames)
+		{
+			unsigned done = 0;
+			while (done < frames) {
+
+				if (!first.fetch() || (second && !second->fetch()))
+					break;
+
+				unsigned n = min(frames - done, first.frames_left());
+				if (second)
+					n = min(n, second->frames_left());
+
+				first.mix(_acc[first.channel()] + done, n);
+				if (second)
+					second->mix(_acc[second->channel()] + done, n);
 
+				done += n;
+			}
+
+			first.played(done, frames);
+			if (second)
+				second->played(done, frames);
+
+			return done;
+		}
 
 	public:
 
-		Out(Genode::Env &env)
-		:
-			_env(env),
-			_data_avail_dispatcher(env.ep(), *this, &Audio_out::Out::_handle_data_avail)
-		{ }
+		enum { DEFAULT_VOLUME = 100, MAX_VOLUME = 400 };
+
+		Mixer(Genode::Env &env) : _env(env)
+		{
+			_config.sigh(_config_handler);
+		}
 
 		static bool channel_number(const char     *name,
 		                           Channel_number *out_number)
@@ -123,48 +324,100 @@ class Audio_out::Out
 			return false;
 		}
 
+		/**
+		 * Label of a session without the channel name as last element
+		 */
+		static Session_label pair_label(Session_label const &label)
+		{
+			Channel_number channel = INVALID;
+
+			Session_label const last = label.last_element();
+			if (channel_number(last.string(), &channel))
+				return label.prefix();
+
+			return label;
+		}
+
+		static unsigned num_sessions(Channel_number channel)
+		{
+			unsigned count = 0;
+			sessions.for_each([&] (Session_component const &session) {
+				if (session.channel() == channel) count++; });
+			return count;
+		}
+
+		unsigned volume(Session_label const &label) const
+		{
+			unsigned volume = DEFAULT_VOLUME;
+
+			with_matching_policy(label, _config.node(), [&] (Node const &policy) {
+				volume = policy.attribute_value("volume", volume); }, [] { });
+
+			return min(volume, unsigned(MAX_VOLUME));
+		}
+
 		Signal_context_capability data_avail() { return _data_avail_dispatcher; }
 
-		Audio::Session::Packet play_packet()
+		void wakeup_sigh(Signal_context_capability sigh) { _wakeup = sigh; }
+
+		size_t play(Audio::Session::Packet const &dst)
 		{
-			Audio::Session::Packet packet { };
+			unsigned const frames =
+				unsigned(dst.size / (sizeof(int16_t) * MAX_CHANNELS));
+
+			unsigned done = 0;
+			while (done < frames) {
+
+				unsigned const n = min(frames - done, unsigned(Audio_out::PERIOD));
+
+				for (float *acc : _acc)
+					bzero(acc, n * sizeof(float));
+
+				_num_active = 0;
+				sessions.for_each([&] (Session_component &session) {
+
+					/* drops the packet state of a stopped session */
+					if (!session.fetch() && !session.active())
+						return;
+
+					/* the number of sessions is limited by 'Root_policy' */
+					if (_num_active < MAX_CHANNELS*MAX_SESSIONS_PER_CHANNEL)
+						_active[_num_active++] = &session;
+				});
 
-			unsigned lpos = left()->pos();
-			unsigned rpos = right()->pos();
+				/* frames provided by the longest-playing session or pair */
+				unsigned mixed = 0;
+				for (unsigned i = 0; i < _num_active; i++) {
 
-			Packet *p_left  = left()->get(lpos);
-			Packet *p_right = right()->get(rpos);
+					Session_component &session = *_active[i];
+					Session_component *partner = _partner(session);
 
-			if (p_left->valid() && p_right->valid()) {
-				/* convert float to S16LE */
-				static short data[Audio_out::PERIOD * Audio_out::MAX_CHANNELS];
+					/* the right session of a pair is mixed with its left one */
+					if (session.channel() == RIGHT && partner)
+						continue;
 
-				for (unsigned i = 0; i < Audio_out::PERIOD * Audio_out::MAX_CHANNELS; i += 2) {
-					data[i] = int16_t(p_left->content()[i / 2] * 32767);
-					data[i + 1] = int16_t(p_right->content()[i / 2] * 32767);
+					mixed = max(mixed, _mix(session, partner, n));
 				}
 
-				packet.data  = data;
-				packet.size  = sizeof(data);
+				if (!mixed)
+					break;
 
-				p_left->invalidate();
-				p_right->invalidate();
+				/* convert float to S16LE, saturated */
+				Audio::Convert::float_to_s16_stereo(dst.data + done * MAX_CHANNELS,
+				                                    _acc[LEFT], _acc[RIGHT], mixed);
+				done += mixed;
 
-				p_left->mark_as_played();
-				p_right->mark_as_played();
-			} else {
-				return packet;
+				if (mixed < n)
+					break;
 			}
 
-			_advance_position(p_left, p_right);
-
-			/* always report when a period has passed */
-			Session_component *channel_left  = channel_acquired[LEFT];
-			Session_component *channel_right = channel_acquired[RIGHT];
-			channel_left->progress_submit();
-			channel_right->progress_submit();
+			return done * sizeof(int16_t) * MAX_CHANNELS;
+		}
 
-			return packet;
+		void generate_report(Generator &g)
+		{
+			sessions.for_each([&] (Session_component &session) {
+				g.node("client", [&] { session.generate_report(g); }); });
 		}
 };
 
@@ -195,13 +448,14 @@ struct Audio_out::Root_policy
 		Arg_string::find_arg(args, "channel").string(channel_name,
 		                                             sizeof(channel_name),
 		                                             "left");
-		if (!Out::channel_number(channel_name, &channel_number)) {
+		if (!Mixer::channel_number(channel_name, &channel_number)) {
 			Genode::error("invalid output channel '",(char const *)channel_name,"' requested, "
 			              "denying '",Genode::label_from_args(args),"'");
 			return Genode::Session_error::DENIED;
 		}
-		if (Audio_out::channel_acquired[channel_number]) {
-			Genode::error("output channel '",(char const *)channel_name,"' is unavailable, "
+		if (Mixer::num_sessions(channel_number) >= MAX_SESSIONS_PER_CHANNEL) {
+			Genode::error("output channel '",(char const *)channel_name,"' has reached "
+			              "the maximum number of sessions, "
 			              "denying '",Genode::label_from_args(args),"'");
 			return Genode::Session_error::DENIED;
 		}
@@ -226,7 +480,7 @@ class Audio_out::Root : public Audio_out::Root_component
 
 		Genode::Env &_env;
 
-		Signal_context_capability _cap;
+		Mixer &_mixer;
 
 	protected:
 
@@ -237,19 +491,22 @@ class Audio_out::Root : public Audio_out::Root_component
 			Arg_string::find_arg(args, "channel").string(channel_name,
 			                                             sizeof(channel_name),
 			                                             "left");
-			Out::channel_number(channel_name, &channel_number);
+			Mixer::channel_number(channel_name, &channel_number);
+
+			Session_label const label = label_from_args(args);
 
 			return *new (md_alloc())
-				Session_component(_env, channel_number, _cap);
+				Session_component(_env, label, channel_number,
+				                  Mixer::pair_label(label),
+				                  _mixer.volume(label), _mixer.data_avail());
 		}
 
 	public:
 
-		Root(Genode::Env &env, Allocator &md_alloc,
-		     Signal_context_capability cap)
+		Root(Genode::Env &env, Allocator &md_alloc, Mixer &mixer)
 		:
 			Root_component(env.ep(), md_alloc),
-			_env(env), _cap(cap)
+			_env(env), _mixer(mixer)
 		{ }
 };
 
@@ -267,6 +524,9 @@ namespace Audio_in {
 	static Session_component *channel_acquired;
 	enum Channel_number { LEFT, MAX_CHANNELS, INVALID = MAX_CHANNELS };
 
+	/* notified when the client starts recording */
+	static Signal_context_capability wakeup;
+
 }
 
 
@@ -284,6 +544,14 @@ class Audio_in::Session_component : public Audio_in::Session_rpc_object
 		{ channel_acquired = this; }
 
 		~Session_component() { channel_acquired = nullptr; }
+
+		void start() override
+		{
+			Session_rpc_object::start();
+
+			if (wakeup.valid())
+				Signal_transmitter(wakeup).submit();
+		}
 };
 
 
@@ -291,12 +559,12 @@ class Audio_in::In
 {
 	private:
 
-		bool _active() { return channel_acquired && channel_acquired->active(); }
-
 		Stream *stream() { return channel_acquired->stream(); }
 
 	public:
 
+		bool active() { return channel_acquired && channel_acquired->active(); }
+
 		static bool channel_number(const char     *name,
 		                           Channel_number *out_number)
 		{
@@ -319,7 +587,7 @@ class Audio_in::In
 
 		void record_packet(Audio::Session::Packet &packet)
 		{
-			if (!_active()) return;
+			if (!active()) return;
 			/*
 			 * Check for an overrun first and notify the client later.
 			 */
@@ -327,16 +595,15 @@ class Audio_in::In
 
 			Packet *p = stream()->alloc();
 
-			float const scale = 32768.0f * 2;
-
 			float * const content = p->content();
-			short * const data    = packet.data;
-			bzero(content, Audio_in::PERIOD * sizeof(float));
 
-			for (unsigned long i = 0; i < packet.size/sizeof(short); i += 2) {
-				float sample = data[i] + data[i+1];
-				content[i/2] = sample / scale;
-			}
+			/* mix both channels into one */
+			unsigned const frames =
+				min(unsigned(packet.size / (sizeof(int16_t) * 2)), unsigned(Audio_in::PERIOD));
+			Audio::Convert::s16_stereo_to_float_mix(content, packet.data, frames);
+
+			if (frames < Audio_in::PERIOD)
+				bzero(content + frames, (Audio_in::PERIOD - frames) * sizeof(float));
 
 			stream()->submit(p);
 
@@ -425,8 +692,8 @@ struct Audio_aggregator : Audio::Session
 	Env       &env;
 	Allocator &alloc;
 
-	Audio_out::Out  out { env };
-	Audio_out::Root out_root { env, alloc, out.data_avail() };
+	Audio_out::Mixer mixer { env };
+	Audio_out::Root  out_root { env, alloc, mixer };
 
 	Audio_in::In   in { };
 	Audio_in::Root in_root { env, alloc };
@@ -438,21 +705,27 @@ struct Audio_aggregator : Audio::Session
 		env.parent().announce(env.ep().manage(in_root));
 	}
 
-	bool _audio_out_active()
+	size_t play(Packet dst) override
 	{
-		using namespace Audio_out;
-		return  channel_acquired[LEFT] && channel_acquired[RIGHT] &&
-	        channel_acquired[LEFT]->active() && channel_acquired[RIGHT]->active();
+		return mixer.play(dst);
 	}
 
-	Packet play_packet(void) override
+	void record_packet(Packet packet, Clock const &) override
 	{
-		return _audio_out_active() ? out.play_packet() : Packet();
+		in.record_packet(packet);
 	}
 
-	void record_packet(Packet packet) override
+	void wakeup_sigh(Signal_context_capability sigh) override
 	{
-		in.record_packet(packet);
+		mixer.wakeup_sigh(sigh);
+		Audio_in::wakeup = sigh;
+	}
+
+	bool capture_wanted() override { return in.active(); }
+
+	void generate_report(Generator &g) override
+	{
+		mixer.generate_report(g);
 	}
 };
 
@@ -468,45 +741,68 @@ struct Record_play_aggregator : Audio::Session
 	{
 		Env &_env;
 
-		/* 16 bit per sample, interleaved left and right */
-		int16_t data[SAMPLES_PER_PERIOD*CHANNELS] { };
-
 		Record::Connection _left  { _env, "left"  };
 		Record::Connection _right { _env, "right" };
 
 		Stereo_output(Env &env) : _env(env) { }
 
-		void clear() { for (auto &e : data) e = 0; }
-
-		void from_record_sessions()
+		/**
+		 * Record up to one period into 'data'
+		 *
+		 * \return true if samples were recorded
+		 */
+		bool _record(int16_t *data, unsigned num)
 		{
 			using Samples_ptr = Record::Connection::Samples_ptr;
 
-			Record::Num_samples const num_samples { SAMPLES_PER_PERIOD };
-
-			auto clamped = [&] (float v)
-			{
-				return (v >  1.0) ?  1.0
-				     : (v < -1.0) ? -1.0
-				     :  v;
-			};
+			Record::Num_samples const num_samples { num };
 
-			auto float_to_s16 = [&] (float v) { return int16_t(clamped(v)*32767); };
+			bool recorded = false;
 
 			_left.record(num_samples,
-				[&] (Record::Time_window const tw, Samples_ptr const &samples) {
-
-					for (unsigned i = 0; i < SAMPLES_PER_PERIOD; i++)
-						data[i*CHANNELS] = float_to_s16(samples.start[i]);
+				[&] (Record::Time_window const tw, Samples_ptr const &left) {
 
+					bool right = false;
 					_right.record_at(tw, num_samples,
 						[&] (Samples_ptr const &samples) {
-							for (unsigned i = 0; i < SAMPLES_PER_PERIOD; i++)
-								data[i*CHANNELS + 1] = float_to_s16(samples.start[i]);
+							Audio::Convert::float_to_s16_stereo(data, left.start,
+							                                    samples.start, num);
+							right = true;
 						});
+
+					/* silent right channel */
+					if (!right)
+						Audio::Convert::float_to_s16_stereo(data, left.start,
+						                                    nullptr, num);
+
+					recorded = true;
 				},
-				[&] { clear(); }
+				[&] { }
 			);
+
+			return recorded;
+		}
+
+		/**
+		 * Record samples directly into the DMA buffer 'dst'
+		 *
+		 * \return number of bytes written
+		 */
+		size_t to_packet(Packet const &dst)
+		{
+			unsigned const frames = unsigned(dst.size / (sizeof(int16_t)*CHANNELS));
+
+			unsigned done = 0;
+			while (done < frames) {
+				unsigned const n = min(frames - done, SAMPLES_PER_PERIOD);
+
+				if (!_record(dst.data + done*CHANNELS, n))
+					break;
+
+				done += n;
+			}
+
+			return done*CHANNELS*sizeof(int16_t);
 		}
 	};
 
@@ -534,12 +830,14 @@ struct Record_play_aggregator : Audio::Session
 
 		Stereo_input(Env &env) : _env(env) { }
 
-		void from_packet(Packet const &packet)
+		void from_packet(Packet const &packet, Clock const &clock)
 		{
 			if (!packet.valid())
 				return;
 
-			Play::Duration const duration_us { 11*1000 };
+			/* duration of the period according to the measured sample rate */
+			Play::Duration const duration_us {
+				unsigned(clock.duration_us(SAMPLES_PER_PERIOD)) };
 			_time_window = _left.schedule_and_enqueue(_time_window, duration_us,
 				[&] (auto &submit) {
 					_for_each_frame(packet, [&] (Frame const frame) {
@@ -556,17 +854,27 @@ struct Record_play_aggregator : Audio::Session
 
 	Record_play_aggregator(Env &env) : _env(env) { }
 
-	Packet play_packet() override
+	size_t play(Packet dst) override
 	{
-		_stereo_output.from_record_sessions();
+		return _stereo_output.to_packet(dst);
+	}
 
-		return { _stereo_output.data, sizeof(Stereo_output::data) };
+	void record_packet(Packet packet, Clock const &clock) override
+	{
+		_stereo_input.from_packet(packet, clock);
 	}
 
-	void record_packet(Packet packet) override
+	/* the record sessions signal when they become active after depletion */
+	void wakeup_sigh(Signal_context_capability sigh) override
 	{
-		_stereo_input.from_packet(packet);
+		_stereo_output._left .wakeup_sigh(sigh);
+		_stereo_output._right.wakeup_sigh(sigh);
 	}
+
+	/* the play sessions do not tell whether the samples are consumed */
+	bool capture_wanted() override { return true; }
+
+	void generate_report(Generator &) override { }
 };
 
 
@@ -15,6 +15,8 @@
 #define _SESSION_H_
 
 #include <base/allocator.h>
+#include <base/signal.h>
+#include <os/reporter.h>
 #include <audio_in_session/audio_in_session.h>
 #include <audio_out_session/audio_out_session.h>
 
@@ -35,8 +37,69 @@ struct Audio::Session
 		bool valid() const { return data != nullptr; }
 	};
 
-	virtual Packet play_packet(void) = 0;
-	virtual void record_packet(Packet) = 0;
+	/*
+	 * Sample clock of the audio interface as measured via the position
+	 * of the DMA controller
+	 */
+	struct Clock
+	{
+		enum : Genode::uint64_t { NOMINAL_RATE_MHZ = 44100*1000 };
+
+		/* sample rate in millihertz */
+		Genode::uint64_t rate_mhz { NOMINAL_RATE_MHZ };
+
+		/* frames transferred and the time of the measurement */
+		Genode::uint64_t frames  { 0 };
+		Genode::uint64_t time_us { 0 };
+
+		Genode::uint64_t duration_us(Genode::uint64_t num_frames) const
+		{
+			return (num_frames*1000*1000*1000 + rate_mhz/2)/rate_mhz;
+		}
+
+		/* deviation from the nominal rate in parts per million */
+		Genode::int64_t drift_ppm() const
+		{
+			return (Genode::int64_t(rate_mhz) - Genode::int64_t(NOMINAL_RATE_MHZ))
+			       *1000*1000/Genode::int64_t(NOMINAL_RATE_MHZ);
+		}
+	};
+
+	/**
+	 * Write interleaved S16 stereo samples to 'dst'
+	 *
+	 * The samples are written directly into the DMA buffer of a
+	 * descriptor, which may be smaller or larger than one period.
+	 *
+	 * \return number of bytes written, the remainder of 'dst' is
+	 *         left untouched
+	 */
+	virtual Genode::size_t play(Packet dst) = 0;
+
+	/**
+	 * Pass captured samples of one period to the session
+	 *
+	 * \param clock  capture clock as sampled at the last DMA interrupt,
+	 *               which is at or after the end of the packet
+	 */
+	virtual void record_packet(Packet, Clock const &clock) = 0;
+
+	/**
+	 * Register signal handler to be notified when a client starts to
+	 * play or record, used to restart stopped DMA channels
+	 */
+	virtual void wakeup_sigh(Genode::Signal_context_capability) = 0;
+
+	/**
+	 * Return true if a client consumes the captured samples
+	 */
+	virtual bool capture_wanted() = 0;
+
+	/**
+	 * Report the state of the clients
+	 */
+	virtual void generate_report(Genode::Generator &) = 0;
+
 	virtual ~Session() { }
 
 	static Session &construct(Genode::Env &env, Genode::Allocator &alloc);
@@ -0,0 +1,244 @@
+/*
+ * \brief  Lookup table for client-chosen handles
+ * \date   2026-10-17
+ *
+ * In contrast to 'Genode::Id_space', looking up an unknown handle is not
+ * reported via an exception but via a null pointer. The table uses open
+ * addressing with linear probing. As clients tend to use densely allocated
+ * handles, the hash function degenerates to direct indexing in the common
+ * case.
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is distributed under the terms of the GNU General Public License
+ * version 2.
+ */
+
+#ifndef _HANDLE_TABLE_H_
+#define _HANDLE_TABLE_H_
+
+/* Genode includes */
+#include <base/allocator.h>
+#include <base/exception.h>
+#include <base/stdint.h>
+#include <util/noncopyable.h>
+
+namespace Gpu { template <typename> class Handle_table; }
+
+
+template <typename T>
+class Gpu::Handle_table : Genode::Noncopyable
+{
+	public:
+
+		struct Id { Genode::uint32_t value; };
+
+		struct Conflicting_id : Genode::Exception { };
+
+		class Element : Genode::Noncopyable
+		{
+			private:
+
+				Handle_table &_table;
+				T            &_obj;
+				Id      const _id;
+
+			public:
+
+				Element(T &obj, Handle_table &table, Id id)
+				:
+					_table { table }, _obj { obj }, _id { id }
+				{
+					_table._insert(_id, _obj);
+				}
+
+				~Element() { _table._remove(_id, _obj); }
+
+				Id id() const { return _id; }
+		};
+
+	private:
+
+		static constexpr unsigned INITIAL_CAPACITY = 64;
+
+		struct Slot
+		{
+			T                *obj;
+			Genode::uint32_t  id;
+
+			bool used() const { return obj != nullptr; }
+		};
+
+		/*
+		 * Noncopyable
+		 */
+		Handle_table(Handle_table const &) = delete;
+		Handle_table &operator = (Handle_table const &) = delete;
+
+		Genode::Allocator &_alloc;
+
+		Slot     *_slots    { nullptr };
+		unsigned  _capacity { 0 };
+		unsigned  _count    { 0 };
+
+		unsigned _mask() const { return _capacity - 1; }
+
+		unsigned _home(Genode::uint32_t id) const
+		{
+			return (id ^ (id >> 16)) & _mask();
+		}
+
+		Slot *_alloc_slots(unsigned capacity)
+		{
+			Slot *slots = new (_alloc) Slot[capacity];
+			for (unsigned i = 0; i < capacity; i++)
+				slots[i] = Slot { nullptr, 0 };
+			return slots;
+		}
+
+		void _free_slots(Slot *slots, unsigned capacity)
+		{
+			if (slots)
+				_alloc.free(slots, sizeof(Slot)*capacity);
+		}
+
+		void _place(Slot const &slot)
+		{
+			unsigned i = _home(slot.id);
+			while (_slots[i].used())
+				i = (i + 1) & _mask();
+			_slots[i] = slot;
+		}
+
+		/* keep the load factor at or below 1/2 */
+		void _grow()
+		{
+			if (2*(_count + 1) <= _capacity)
+				return;
+
+			unsigned const old_capacity = _capacity;
+			Slot     *     old_slots    = _slots;
+
+			_capacity = old_capacity ? 2*old_capacity : INITIAL_CAPACITY;
+			_slots    = _alloc_slots(_capacity);
+
+			for (unsigned i = 0; i < old_capacity; i++)
+				if (old_slots[i].used())
+					_place(old_slots[i]);
+
+			_free_slots(old_slots, old_capacity);
+		}
+
+		long _index_of(Genode::uint32_t id) const
+		{
+			if (!_capacity)
+				return -1;
+
+			for (unsigned i = _home(id); _slots[i].used(); i = (i + 1) & _mask())
+				if (_slots[i].id == id)
+					return i;
+
+			return -1;
+		}
+
+		void _insert(Id id, T &obj)
+		{
+			if (_index_of(id.value) >= 0)
+				throw Conflicting_id();
+
+			_grow();
+			_place(Slot { &obj, id.value });
+			_count++;
+		}
+
+		void _remove(Id id, T &obj)
+		{
+			long const index = _index_of(id.value);
+			if (index < 0 || _slots[index].obj != &obj)
+				return;
+
+			/* backward-shift deletion keeps probe sequences intact */
+			unsigned i = unsigned(index);
+			_slots[i] = Slot { nullptr, 0 };
+
+			for (unsigned j = (i + 1) & _mask(); _slots[j].used(); j = (j + 1) & _mask()) {
+
+				unsigned const home = _home(_slots[j].id);
+
+				bool const in_place = (i <= j) ? (i < home && home <= j)
+				                               : (i < home || home <= j);
+				if (in_place)
+					continue;
+
+				_slots[i] = _slots[j];
+				_slots[j] = Slot { nullptr, 0 };
+				i = j;
+			}
+
+			_count--;
+		}
+
+	public:
+
+		Handle_table(Genode::Allocator &alloc) : _alloc { alloc } { }
+
+		~Handle_table() { _free_slots(_slots, _capacity); }
+
+		T *lookup(Id id) const
+		{
+			long const index = _index_of(id.value);
+			return index < 0 ? nullptr : _slots[index].obj;
+		}
+
+		/**
+		 * Apply 'fn' to the object with the given id
+		 *
+		 * \return false if the id is unknown
+		 */
+		template <typename FN>
+		bool apply(Id id, FN const &fn)
+		{
+			T * const obj = lookup(id);
+			if (!obj)
+				return false;
+
+			fn(*obj);
+			return true;
+		}
+
+		/**
+		 * Apply 'fn' to an arbitrary object
+		 *
+		 * In contrast to 'for_each', 'fn' may destroy the object.
+		 *
+		 * \return false if the table is empty
+		 */
+		template <typename FN>
+		bool apply_any(FN const &fn)
+		{
+			for (unsigned i = 0; i < _capacity; i++)
+				if (_slots[i].used()) {
+					fn(*_slots[i].obj);
+					return true;
+				}
+
+			return false;
+		}
+
+		/**
+		 * Apply 'fn' to each object, 'fn' must not destroy the object
+		 */
+		template <typename FN>
+		void for_each(FN const &fn)
+		{
+			for (unsigned i = 0; i < _capacity; i++)
+				if (_slots[i].used())
+					fn(*_slots[i].obj);
+		}
+
+		unsigned count() const { return _count; }
+};
+
+#endif /* _HANDLE_TABLE_H_ */
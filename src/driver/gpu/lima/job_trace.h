@@ -0,0 +1,328 @@
+/*
+ * \brief  Ring of timestamped driver events exported as Chrome trace
+ * \date   2026-10-17
+ *
+ * The events are kept in a fixed-size ring that overwrites the oldest
+ * events. On request, the ring is converted into the JSON trace-event
+ * format understood by 'chrome://tracing' and Perfetto. Each session
+ * appears as a process, the GPU pipes appear as threads of a dedicated
+ * 'GPU' process.
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is distributed under the terms of the GNU General Public License
+ * version 2.
+ */
+
+#ifndef _JOB_TRACE_H_
+#define _JOB_TRACE_H_
+
+/* Genode includes */
+#include <base/allocator.h>
+#include <base/output.h>
+#include <base/session_label.h>
+#include <util/noncopyable.h>
+#include <util/string.h>
+
+namespace Gpu { class Job_trace; }
+
+
+class Gpu::Job_trace : Genode::Noncopyable
+{
+	public:
+
+		/*
+		 * Threads within the process of a session, the pipe number is
+		 * used as thread of the 'GPU' process
+		 */
+		enum Lane { WORKER = 0, CLIENT = 1 };
+
+		enum { NO_PIPE = ~0U };
+
+		enum { MAX_LABELS = 32 };
+
+		/*
+		 * Interned session label, the generation tells apart the labels
+		 * a slot held over time
+		 */
+		struct Label_id
+		{
+			unsigned value;
+			unsigned generation;
+
+			static Label_id unknown() { return { MAX_LABELS, 0 }; }
+		};
+
+	private:
+
+		struct Event
+		{
+			Genode::uint64_t  begin_us;
+			Genode::uint64_t  end_us;
+			char const       *name;
+			Label_id          label;
+			unsigned          pipe;
+			bool              gpu;
+			unsigned          lane;
+		};
+
+		/*
+		 * Noncopyable
+		 */
+		Job_trace(Job_trace const &) = delete;
+		Job_trace &operator = (Job_trace const &) = delete;
+
+		Genode::Allocator &_alloc;
+
+		unsigned const _capacity;
+
+		Event * const _events;
+
+		unsigned _next  { 0 };
+		unsigned _count { 0 };
+
+		/*
+		 * Labels are interned so that events stay small. A slot is free
+		 * once all sessions with the label are closed. It keeps the label
+		 * for the events still in the ring until it is assigned anew.
+		 */
+		struct Label_slot
+		{
+			Genode::Session_label label;
+			unsigned              generation;
+			unsigned              users;
+		};
+
+		Label_slot _labels[MAX_LABELS] { };
+
+		/*
+		 * Label of an event, "unknown" if the label table was full or
+		 * the slot got assigned to another label meanwhile
+		 */
+		char const *_label(Label_id id) const
+		{
+			if (id.value >= MAX_LABELS)
+				return "unknown";
+
+			Label_slot const &slot = _labels[id.value];
+
+			return slot.generation == id.generation ? slot.label.string()
+			                                        : "unknown";
+		}
+
+		/* process ID of the session of an event, 0 is the 'GPU' process */
+		unsigned _pid(Label_id id) const
+		{
+			if (id.value >= MAX_LABELS
+			 || _labels[id.value].generation != id.generation)
+				return MAX_LABELS + 1;
+
+			return id.value + 1;
+		}
+
+		void _record(Event const &event)
+		{
+			_events[_next] = event;
+			_next  = (_next + 1) % _capacity;
+			_count = Genode::min(_count + 1, _capacity);
+		}
+
+		/*
+		 * Label printed as JSON string content
+		 */
+		struct Json_string
+		{
+			char const *s;
+
+			void print(Genode::Output &out) const
+			{
+				for (char const *c = s; *c; c++) {
+					if (*c == '"' || *c == '\\')
+						out.out_char('\\');
+					if ((unsigned char)*c >= 0x20)
+						out.out_char(*c);
+				}
+			}
+		};
+
+		/*
+		 * Output writing into a byte range, dropping what does not fit
+		 */
+		struct Range_output : Genode::Output
+		{
+			Genode::Byte_range_ptr const &_dst;
+
+			Genode::size_t _used { 0 };
+			bool           _exceeded { false };
+
+			Range_output(Genode::Byte_range_ptr const &dst) : _dst { dst } { }
+
+			void out_char(char c) override
+			{
+				if (_used < _dst.num_bytes)
+					_dst.start[_used++] = c;
+				else
+					_exceeded = true;
+			}
+		};
+
+	public:
+
+		Job_trace(Genode::Allocator &alloc, unsigned capacity)
+		:
+			_alloc    { alloc },
+			_capacity { Genode::max(capacity, 1U) },
+			_events   { new (alloc) Event[_capacity] }
+		{ }
+
+		~Job_trace() { _alloc.free(_events, sizeof(Event)*_capacity); }
+
+		/**
+		 * Intern label of a new session
+		 *
+		 * \return 'Label_id::unknown()' if all slots are in use
+		 */
+		Label_id label_id(Genode::Session_label const &label)
+		{
+			for (unsigned i = 0; i < MAX_LABELS; i++) {
+				Label_slot &slot = _labels[i];
+				if (slot.label == label) {
+					slot.users++;
+					return { i, slot.generation };
+				}
+			}
+
+			/* prefer a slot that never held a label */
+			Label_slot *free = nullptr;
+			for (Label_slot &slot : _labels)
+				if (!slot.users && (!free || !slot.label.valid()))
+					free = &slot;
+
+			if (!free)
+				return Label_id::unknown();
+
+			free->label = label;
+			free->generation++;
+			free->users = 1;
+			return { unsigned(free - _labels), free->generation };
+		}
+
+		/**
+		 * Release label on session close
+		 */
+		void release(Label_id id)
+		{
+			if (id.value >= MAX_LABELS)
+				return;
+
+			Label_slot &slot = _labels[id.value];
+			if (slot.generation == id.generation && slot.users)
+				slot.users--;
+		}
+
+		/**
+		 * Record operation performed on behalf of a session
+		 */
+		void session_event(char const *name, Label_id label, Lane lane,
+		                   unsigned pipe, Genode::uint64_t begin_us,
+		                   Genode::uint64_t end_us)
+		{
+			_record({ .begin_us = begin_us, .end_us = end_us, .name = name,
+			          .label = label, .pipe = pipe, .gpu = false,
+			          .lane = lane });
+		}
+
+		/**
+		 * Record execution of a job by the GPU
+		 */
+		void gpu_event(char const *name, Label_id label, unsigned pipe,
+		               Genode::uint64_t begin_us, Genode::uint64_t end_us)
+		{
+			_record({ .begin_us = begin_us, .end_us = end_us, .name = name,
+			          .label = label, .pipe = pipe, .gpu = true,
+			          .lane = pipe });
+		}
+
+		/**
+		 * Write ring as Chrome trace JSON into 'dst'
+		 *
+		 * \return number of bytes written, the newest events are omitted
+		 *         if 'dst' is too small
+		 */
+		Genode::size_t generate_json(Genode::Byte_range_ptr const &dst) const
+		{
+			using Genode::print;
+
+			Range_output out { dst };
+
+			/* keep headroom for the closing of the JSON document */
+			Genode::Byte_range_ptr const body { dst.start,
+			                                    dst.num_bytes > 16 ? dst.num_bytes - 16 : 0 };
+			Range_output body_out { body };
+
+			bool first = true;
+			auto separate = [&] (Genode::Output &o) {
+				if (!first)
+					print(o, ",\n");
+				first = false;
+			};
+
+			print(body_out, "{\"traceEvents\":[\n");
+
+			/* process and thread names */
+			separate(body_out);
+			print(body_out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,"
+			                "\"args\":{\"name\":\"GPU\"}}");
+			char const *pipe_names[] = { "GP", "PP" };
+			for (unsigned pipe = 0; pipe < 2; pipe++) {
+				separate(body_out);
+				print(body_out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+				                "\"tid\":", pipe, ",\"args\":{\"name\":\"",
+				                pipe_names[pipe], "\"}}");
+			}
+			for (unsigned i = 0; i < MAX_LABELS; i++) {
+				if (!_labels[i].label.valid())
+					continue;
+
+				separate(body_out);
+				print(body_out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":",
+				      i + 1, ",\"args\":{\"name\":\"",
+				      Json_string { _labels[i].label.string() }, "\"}}");
+			}
+			separate(body_out);
+			print(body_out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":",
+			      unsigned(MAX_LABELS + 1), ",\"args\":{\"name\":\"unknown\"}}");
+
+			unsigned const oldest = (_next + _capacity - _count) % _capacity;
+			for (unsigned n = 0; n < _count && !body_out._exceeded; n++) {
+
+				Event const &e = _events[(oldest + n) % _capacity];
+
+				separate(body_out);
+				print(body_out, "{\"name\":\"", e.name, "\",\"ph\":\"X\","
+				      "\"ts\":", e.begin_us, ",\"dur\":", e.end_us - e.begin_us, ","
+				      "\"pid\":", e.gpu ? 0 : _pid(e.label), ","
+				      "\"tid\":", e.lane, ","
+				      "\"args\":{\"session\":\"",
+				      Json_string { _label(e.label) }, "\"");
+				if (e.pipe != NO_PIPE)
+					print(body_out, ",\"pipe\":", e.pipe);
+				print(body_out, "}}");
+			}
+
+			/* drop a partially written event, leaving a trailing separator */
+			Genode::size_t used = body_out._used;
+			if (body_out._exceeded)
+				while (used && dst.start[used - 1] != '\n')
+					used--;
+
+			out._used = used;
+			print(out, body_out._exceeded ? "{}]}\n" : "]}\n");
+
+			return out._used;
+		}
+};
+
+#endif /* _JOB_TRACE_H_ */
@@ -21,12 +21,16 @@ extern "C" {
 void *lx_drm_open(void);
 void  lx_drm_close(void *);
 
+int lx_drm_gpu_suspend(void);
+int lx_drm_gpu_resume(void);
+
 void      lx_drm_gem_submit_ctx_id(void *, unsigned);
 void      lx_drm_gem_submit_set_out_sync(void *, unsigned);
 unsigned  lx_drm_gem_submit_bo_count(void const *);
 unsigned *lx_drm_gem_submit_bo_handle(void *, unsigned);
 bool      lx_drm_gem_submit_bo_read(void *, unsigned);
 unsigned  lx_drm_gem_submit_out_sync(void const *);
+unsigned *lx_drm_gem_submit_in_sync(void *, unsigned);
 unsigned  lx_drm_gem_submit_pipe(void const *);
 
 int lx_drm_gem_close(void *, unsigned int);
@@ -38,7 +42,9 @@ int lx_drm_gem_prime_fd_to_handle(void *, int, unsigned int *);
 
 int lx_drm_ioctl_syncobj_create(void *, unsigned int *);
 int lx_drm_ioctl_syncobj_destroy(void *, unsigned int);
-int lx_drm_ioctl_syncobj_wait(void *, unsigned int);
+int lx_drm_ioctl_syncobj_wait(void *, unsigned int const *, unsigned int, bool);
+int lx_drm_syncobj_signal_callback(void *, unsigned int, void (*)(void *), void *);
+int lx_drm_syncobj_transfer(void *, unsigned int, void *, unsigned int);
 
 int lx_drm_ioctl_lima_ctx_create(void *, unsigned int *);
 int lx_drm_ioctl_lima_ctx_free(void *, unsigned int);
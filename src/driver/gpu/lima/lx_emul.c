@@ -206,6 +206,11 @@ void *lx_drm_open(void)
 	if (err)
 		goto free_file;
 
+	if (!_lx_drm_device) {
+		struct drm_file *drm_file = lx_drm_prv->file->private_data;
+		_lx_drm_device = drm_file->minor->dev;
+	}
+
 	return lx_drm_prv;
 
 free_file:
@@ -239,6 +244,30 @@ void lx_drm_close(void *p)
 }
 
 
+#include <../drivers/gpu/drm/lima/lima_device.h>
+
+/*
+ * The device is known after the first DRM file was opened
+ */
+
+int lx_drm_gpu_suspend(void)
+{
+	if (!_lx_drm_device)
+		return -ENODEV;
+
+	return lima_device_suspend(_lx_drm_device->dev);
+}
+
+
+int lx_drm_gpu_resume(void)
+{
+	if (!_lx_drm_device)
+		return -ENODEV;
+
+	return lima_device_resume(_lx_drm_device->dev);
+}
+
+
 #include <drm/drm_ioctl.h>
 #include <uapi/drm/drm.h>
 #include <uapi/drm/lima_drm.h>
@@ -301,6 +330,18 @@ unsigned lx_drm_gem_submit_out_sync(void const *p)
 }
 
 
+unsigned *lx_drm_gem_submit_in_sync(void *p, unsigned index)
+{
+	struct drm_lima_gem_submit * const submit =
+		(struct drm_lima_gem_submit *)p;
+
+	if (index >= ARRAY_SIZE(submit->in_sync))
+		return NULL;
+
+	return &submit->in_sync[index];
+}
+
+
 unsigned lx_drm_gem_submit_pipe(void const *p)
 {
 	struct drm_lima_gem_submit const * const submit =
@@ -448,23 +489,37 @@ int lx_drm_ioctl_syncobj_destroy(void *p, unsigned int handle)
 }
 
 
-int lx_drm_ioctl_syncobj_wait(void *p, unsigned int handle)
+/*
+ * Poll the given sync objects without blocking
+ *
+ * Returns 0 if all or, if 'wait_all' is false, any of the sync objects
+ * is signaled and 1 otherwise.
+ */
+int lx_drm_ioctl_syncobj_wait(void *p, unsigned int const *handles,
+                              unsigned int count, bool wait_all)
 {
 	int err;
 	struct lx_drm_private *lx_drm_prv;
+	unsigned int i;
 
-	enum { COUNT_HANDLES = 1 };
-	uint64_t handles[COUNT_HANDLES] = { handle };
+	enum { MAX_HANDLES = 2 };
+	uint64_t req_handles[MAX_HANDLES];
 
 	struct drm_syncobj_wait req = {
-		.handles        = (uint64_t)handles,
-		.timeout_nsec   = 4611686018427387904, // excessive large timeout
-		.count_handles  = COUNT_HANDLES,
-		.flags          = 0,
+		.handles        = (uint64_t)req_handles,
+		.timeout_nsec   = 0, /* already expired, i.e., poll */
+		.count_handles  = count,
+		.flags          = wait_all ? DRM_SYNCOBJ_WAIT_FLAGS_WAIT_ALL : 0,
 		.first_signaled = 0,
 		.pad            = 0,
 	};
 
+	if (!count || count > MAX_HANDLES)
+		return -EINVAL;
+
+	for (i = 0; i < count; i++)
+		req_handles[i] = handles[i];
+
 	lx_drm_prv = (struct lx_drm_private*)p;
 
 	err = drm_ioctl(lx_drm_prv->file, DRM_IOCTL_SYNCOBJ_WAIT,
@@ -478,6 +533,103 @@ int lx_drm_ioctl_syncobj_wait(void *p, unsigned int handle)
 }
 
 
+#include <drm/drm_syncobj.h>
+#include <linux/dma-fence.h>
+
+struct lx_drm_signal_callback
+{
+	struct dma_fence_cb cb;
+
+	void (*fn)(void *);
+	void  *arg;
+};
+
+
+static void lx_drm_fence_signaled(struct dma_fence *fence,
+                                  struct dma_fence_cb *cb)
+{
+	struct lx_drm_signal_callback *sc =
+		container_of(cb, struct lx_drm_signal_callback, cb);
+
+	sc->fn(sc->arg);
+	kfree(sc);
+}
+
+
+int lx_drm_syncobj_signal_callback(void *p, unsigned int handle,
+                                   void (*fn)(void *), void *arg)
+{
+	int err;
+	struct lx_drm_private *lx_drm_prv;
+	struct dma_fence *fence;
+	struct lx_drm_signal_callback *sc;
+
+	lx_drm_prv = (struct lx_drm_private*)p;
+
+	err = drm_syncobj_find_fence(lx_drm_prv->file->private_data, handle,
+	                             0, 0, &fence);
+	if (err)
+		return err;
+
+	sc = kzalloc(sizeof (struct lx_drm_signal_callback), 0);
+	if (!sc) {
+		dma_fence_put(fence);
+		return -ENOMEM;
+	}
+
+	sc->fn  = fn;
+	sc->arg = arg;
+
+	err = dma_fence_add_callback(fence, &sc->cb, lx_drm_fence_signaled);
+
+	/* fence is already signaled */
+	if (err == -ENOENT) {
+		fn(arg);
+		kfree(sc);
+		err = 0;
+	}
+
+	dma_fence_put(fence);
+	return err;
+}
+
+
+/*
+ * Replace the fence of the sync object 'dst_handle' of the DRM file 'dst_p'
+ * by the current fence of the sync object 'src_handle' of 'src_p'
+ *
+ * This allows a job of one file to depend on a job of another file, which
+ * user space would otherwise have to accomplish via a sync file.
+ */
+int lx_drm_syncobj_transfer(void *src_p, unsigned int src_handle,
+                            void *dst_p, unsigned int dst_handle)
+{
+	int err;
+	struct lx_drm_private *src, *dst;
+	struct dma_fence *fence;
+	struct drm_syncobj *syncobj;
+
+	src = (struct lx_drm_private*)src_p;
+	dst = (struct lx_drm_private*)dst_p;
+
+	err = drm_syncobj_find_fence(src->file->private_data, src_handle,
+	                             0, 0, &fence);
+	if (err)
+		return err;
+
+	syncobj = drm_syncobj_find(dst->file->private_data, dst_handle);
+	if (!syncobj) {
+		dma_fence_put(fence);
+		return -ENOENT;
+	}
+
+	drm_syncobj_replace_fence(syncobj, fence);
+
+	drm_syncobj_put(syncobj);
+	dma_fence_put(fence);
+	return 0;
+}
+
 /*
  * The next functions are used by the Gpu lx_drm_prv to perform I/O controls.
  */
@@ -568,9 +720,10 @@ int lx_drm_ioctl_lima_gem_create(void *lx_drm_prv,
                                  unsigned int *handle)
 {
 	int err;
+	/* a virtual address of 0 leaves the choice to the kernel's VM */
 	struct drm_lima_gem_create req = {
 		.size   = size,
-		.flags  = LIMA_BO_FLAG_FORCE_VA, // FORCE va
+		.flags  = va ? LIMA_BO_FLAG_FORCE_VA : 0,
 		.handle = 0,
 		.va     = va,
 	};
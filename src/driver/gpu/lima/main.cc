@@ -12,6 +12,7 @@
  */
 
 /* Genode includes */
+#include <base/attached_dataspace.h>
 #include <base/attached_ram_dataspace.h>
 #include <base/attached_rom_dataspace.h>
 #include <base/component.h>
@@ -22,9 +23,16 @@
 #include <base/signal.h>
 #include <base/sleep.h>
 #include <gpu/info_lima.h>
+#include <gpu/lima_session.h>
 #include <gpu_session/gpu_session.h>
+#include <os/reporter.h>
+#include <os/session_policy.h>
+#include <report_session/connection.h>
 #include <root/component.h>
 #include <session/session.h>
+#include <timer_session/connection.h>
+#include <util/list.h>
+#include <util/reconstructible.h>
 
 /* emulation includes */
 #include <lx_emul/init.h>
@@ -34,7 +42,10 @@
 
 
 /* local includes */
+#include "handle_table.h"
+#include "job_trace.h"
 #include "lx_drm.h"
+#include "submit_cache.h"
 
 extern Genode::Dataspace_capability genode_lookup_cap(void *, unsigned long long, unsigned long);
 
@@ -42,6 +53,7 @@ namespace Gpu {
 
 	using namespace Genode;
 
+	struct Config;
 	struct Session_component;
 	using Session_space = Genode::Id_space<Session_component>;
 	struct Root;
@@ -50,8 +62,14 @@ namespace Gpu {
 
 	struct Operation;
 	struct Request;
+	struct Request_queue;
 	struct Local_request;
 
+	struct Session_stats;
+	struct Fair_share;
+	struct Fence_tracker;
+	struct Runtime_pm;
+	struct Drm_pool;
 	struct Worker_args;
 
 	struct Ctx_id;
@@ -61,6 +79,51 @@ namespace Gpu {
 } /* namespace Gpu */
 
 
+struct Gpu::Config
+{
+	/*
+	 * Rely on the client to announce CPU writes by mapping a buffer or
+	 * waiting on it for writing instead of flushing buffers with an
+	 * outstanding writeable CPU mapping on every submit
+	 */
+	bool dirty_hints;
+
+	/* upper bound of freed buffer objects kept for reuse per session */
+	Genode::size_t bo_cache;
+
+	/* available RAM below which the buffer-object caches are trimmed */
+	Genode::size_t bo_cache_min_ram;
+
+	bool verbose;
+
+	/* GPU time a session may run ahead of others according to its weight */
+	Genode::uint64_t fair_slice_us;
+
+	/* time without submits after which the GPU is suspended, 0 disables */
+	Genode::uint64_t idle_timeout_us;
+
+	/* number of DRM files prepared in advance for new sessions */
+	unsigned drm_pool;
+
+	static Config from_node(Genode::Node const &node)
+	{
+		using Genode::Number_of_bytes;
+
+		return {
+			.dirty_hints      = node.attribute_value("dirty_hints", false),
+			.bo_cache         = node.attribute_value("bo_cache",
+			                                         Number_of_bytes(8*1024*1024)),
+			.bo_cache_min_ram = node.attribute_value("bo_cache_min_ram",
+			                                         Number_of_bytes(16*1024*1024)),
+			.verbose          = node.attribute_value("verbose", false),
+			.fair_slice_us    = 1000*node.attribute_value("fair_slice_ms", 16UL),
+			.idle_timeout_us  = 1000*node.attribute_value("idle_timeout_ms", 0UL),
+			.drm_pool         = node.attribute_value("drm_pool", 0U),
+		};
+	}
+};
+
+
 struct Gpu::Ctx_id
 {
 	uint32_t value;
@@ -82,13 +145,12 @@ struct Gpu::Operation
 		EXEC            = 5,
 		WAIT            = 6,
 		CTX_CREATE      = 7,
-		CTX_FREE        = 8,
 		SYNCOBJ_CREATE  = 9,
-		SYNCOBJ_DESTROY = 10,
 		SYNCOBJ_WAIT    = 11,
 		CLOSE           = 14,
 		OPEN            = 15,
 		FLINK           = 16,
+		TRIM            = 17,
 	};
 
 	Type type;
@@ -108,6 +170,15 @@ struct Gpu::Operation
 	enum { MAX_PIPE = 2 };
 	Syncobj_id syncobj_id[MAX_PIPE];
 
+	/*
+	 * Copy of the submit arguments of a held-back EXEC, used instead of
+	 * the buffer named by 'id'
+	 */
+	void *submit;
+
+	/* semantics of SYNCOBJ_WAIT, given as 'op' */
+	enum { WAIT_ANY = 0, WAIT_ALL = 1 };
+
 	bool valid() const
 	{
 		return type != Type::INVALID;
@@ -122,13 +193,12 @@ struct Gpu::Operation
 		case Type::EXEC:       return "EXEC";
 		case Type::WAIT:       return "WAIT";
 		case Type::CTX_CREATE: return "CTX_CREATE";
-		case Type::CTX_FREE:   return "CTX_FREE";
 		case Type::SYNCOBJ_CREATE:  return "SYNCOBJ_CREATE";
-		case Type::SYNCOBJ_DESTROY: return "SYNCOBJ_DESTROY";
 		case Type::SYNCOBJ_WAIT:    return "SYNCOBJ_WAIT";
 		case Type::CLOSE:           return "CLOSE";
 		case Type::OPEN:            return "OPEN";
 		case Type::FLINK:           return "FLINK";
+		case Type::TRIM:            return "TRIM";
 		}
 		return "INVALID";
 	}
@@ -136,7 +206,7 @@ struct Gpu::Operation
 	void print(Genode::Output &out) const
 	{
 		Genode::print(out, type_name(type));
-		if (type == Type::CTX_CREATE || type == Type::CTX_FREE || type == Type::EXEC)
+		if (type == Type::CTX_CREATE || type == Type::EXEC)
 			Genode::print(out, " ctx_id: ", ctx_id.value);
 	}
 };
@@ -187,6 +257,7 @@ struct Gpu::Request
 					Syncobj_id { .value = 0 },
 					Syncobj_id { .value = 0 },
 				},
+				.submit = nullptr,
 			},
 			.success = false,
 			.tag = Tag { ++tag_counter }
@@ -200,6 +271,118 @@ struct Gpu::Request
 };
 
 
+/*
+ * Bounded FIFO of requests shared between a session and its worker task
+ *
+ * The session enqueues requests at the tail while the worker drains all
+ * queued requests in one batch whenever it gets scheduled. A request stays
+ * in the queue while the worker processes it so that the session is able
+ * to tell an in-flight request, e.g. a blocking WAIT, apart from a finished
+ * one. Completed requests the session is interested in are moved to a small
+ * completion table from where they are collected by their tag. Requests
+ * that are enqueued as deferred, e.g. FREE or CLOSE, do not produce a
+ * completion.
+ */
+struct Gpu::Request_queue
+{
+	enum { CAPACITY = 64, MAX_COMPLETED = 4 };
+
+	struct Entry
+	{
+		Request request;
+		bool    collect;
+	};
+
+	Entry    _entries[CAPACITY] { };
+	unsigned _head { 0 };
+	unsigned _tail { 0 };
+
+	Request  _completed[MAX_COMPLETED] { };
+	unsigned _completed_next { 0 };
+
+	bool _in_progress { false };
+
+	Entry &_entry(unsigned i) { return _entries[i % CAPACITY]; }
+
+	bool full()  const { return _tail - _head == CAPACITY; }
+	bool empty() const { return _tail == _head; }
+
+	unsigned queued() const { return _tail - _head; }
+
+	/*
+	 * The worker only yields while processing a request if that
+	 * request blocks, e.g. when waiting for a sync object.
+	 */
+	bool worker_blocked() const { return _in_progress; }
+
+	bool enqueue(Request const &request, bool collect)
+	{
+		if (full())
+			return false;
+
+		_entry(_tail++) = Entry { .request = request, .collect = collect };
+		return true;
+	}
+
+	/**
+	 * Process all queued requests in FIFO order
+	 *
+	 * Called by the worker task.
+	 */
+	template <typename FN>
+	void drain(FN const &fn)
+	{
+		while (!empty()) {
+
+			_in_progress = true;
+			Request const r = fn(_entry(_head).request);
+			_in_progress = false;
+
+			Entry const &e = _entry(_head++);
+			if (!e.collect)
+				continue;
+
+			/* overwrite the oldest completion if nobody collected it */
+			_completed[_completed_next++ % MAX_COMPLETED] = r;
+		}
+	}
+
+	bool in_flight(Request::Tag tag)
+	{
+		for (unsigned i = _head; i != _tail; i++)
+			if (_entry(i).request.tag.value == tag.value)
+				return true;
+
+		return false;
+	}
+
+	/**
+	 * Drop interest in the result of a still queued request
+	 */
+	void orphan(Request::Tag tag)
+	{
+		for (unsigned i = _head; i != _tail; i++)
+			if (_entry(i).request.tag.value == tag.value)
+				_entry(i).collect = false;
+	}
+
+	template <typename FN>
+	bool with_completed(Request::Tag tag, FN const &fn)
+	{
+		for (Request &r : _completed) {
+			if (!r.valid() || r.tag.value != tag.value)
+				continue;
+
+			Request const completed = r;
+			r = Request();
+			fn(completed);
+			return true;
+		}
+		return false;
+	}
+};
+
+
 struct Gpu::Local_request
 {
 	enum class Type { INVALID = 0, OPEN, CLOSE };
@@ -208,52 +391,328 @@ struct Gpu::Local_request
 };
 
 
-struct Buffer_object
+extern "C" void lx_emul_mem_cache_clean_invalidate(const void * addr,
+                                                   unsigned long size);
+
+
+struct Buffer_object : Genode::List<Buffer_object>::Element
 {
-	Genode::Id_space<Buffer_object>::Element const _elem;
+	using Element = Gpu::Handle_table<Buffer_object>::Element;
+
+	/* not constructed while the buffer object resides in the cache */
+	Genode::Constructible<Element> _elem { };
 
 	Genode::uint32_t             const handle;
 	Genode::Dataspace_capability const cap;
 	Genode::Attached_dataspace         attached_ds;
 
 	Genode::uint32_t const va;
+	Genode::size_t   const size;
 
-	Buffer_object(Genode::Id_space<Buffer_object> &space,
+	/* virtual address was chosen by the driver */
+	bool const driver_va;
+
+	/*
+	 * Part of the buffer that may hold CPU-written data that has not
+	 * been cleaned from the data cache yet, given as offsets into
+	 * 'attached_ds'
+	 */
+	struct Dirty_range
+	{
+		Genode::size_t start, end;
+
+		bool empty() const { return start >= end; }
+	};
+
+	Dirty_range _dirty { 0, attached_ds.size() };
+
+	/*
+	 * As long as the client holds a writeable CPU mapping and does not
+	 * announce its writes, the buffer has to be treated as dirty on
+	 * every submit.
+	 */
+	bool _sticky_dirty { false };
+
+	/*
+	 * Sync object of the exporting DRM file that holds the fence of the
+	 * last job of the exporting session using the buffer, created when
+	 * the buffer is exported
+	 */
+	void             *fence_drm     { nullptr };
+	Genode::uint32_t  fence_syncobj { 0 };
+
+	Buffer_object(Gpu::Handle_table<Buffer_object> &space,
 	              Gpu::Vram_id                     id,
 	              Genode::uint32_t                 handle,
 	              Genode::uint32_t                 va,
+	              Genode::size_t                   size,
+	              bool                             driver_va,
 	              Genode::Dataspace_capability     cap,
 	              Genode::Env::Local_rm           &rm)
 	:
-		_elem       { *this, space,
-		              Genode::Id_space<Buffer_object>::Id { .value = id.value } },
 		handle      { handle },
 		cap         { cap },
 		attached_ds { rm, cap },
-		va          { va }
-	{ }
-};
+		va          { va },
+		size        { size },
+		driver_va   { driver_va }
+	{
+		bind(space, id);
+	}
 
+	void bind(Gpu::Handle_table<Buffer_object> &space, Gpu::Vram_id id)
+	{
+		_elem.construct(*this, space,
+		                Gpu::Handle_table<Buffer_object>::Id { .value = id.value });
+	}
 
-extern "C" void lx_emul_mem_cache_clean_invalidate(const void * addr,
-                                                   unsigned long size);
+	void unbind() { _elem.destruct(); }
+
+	bool overlaps(Genode::uint32_t other_va, Genode::size_t other_size) const
+	{
+		return Genode::uint64_t(va) < Genode::uint64_t(other_va) + other_size
+		    && Genode::uint64_t(other_va) < Genode::uint64_t(va) + size;
+	}
+
+	void mark_dirty(Genode::size_t offset, Genode::size_t size)
+	{
+		Genode::size_t const end = Genode::min(offset + size, attached_ds.size());
+
+		if (_dirty.empty())
+			_dirty = { offset, end };
+		else
+			_dirty = { Genode::min(_dirty.start, offset),
+			           Genode::max(_dirty.end, end) };
+	}
+
+	void mark_dirty() { mark_dirty(0, attached_ds.size()); }
+
+	void cpu_mapped(bool writeable, bool trust_hints)
+	{
+		if (!writeable)
+			return;
+
+		mark_dirty();
+		_sticky_dirty = !trust_hints;
+	}
+
+	void cpu_unmapped() { _sticky_dirty = false; }
+
+	/**
+	 * Clean and invalidate the dirty range
+	 *
+	 * \return number of bytes flushed
+	 */
+	Genode::size_t flush_dirty()
+	{
+		if (_dirty.empty())
+			return 0;
 
-struct Buffer_object_space : Genode::Id_space<Buffer_object>
+		Genode::size_t const size = _dirty.end - _dirty.start;
+		lx_emul_mem_cache_clean_invalidate(attached_ds.local_addr<char>() + _dirty.start,
+		                                   size);
+
+		if (!_sticky_dirty)
+			_dirty = { 0, 0 };
+
+		return size;
+	}
+};
+
+
+struct Buffer_object_space : Gpu::Handle_table<Buffer_object>
 {
 	Genode::Allocator &_alloc;
 
-	Buffer_object_space(Genode::Allocator &alloc) : _alloc { alloc } { }
+	/*
+	 * Cache of freed buffer objects
+	 *
+	 * Instead of closing the GEM handle of a freed buffer object, the
+	 * buffer object is kept, including its local mapping, and handed out
+	 * again on an allocation of the same size at the same GPU virtual
+	 * address. The GPU virtual address has to match if it is chosen by
+	 * the client as it is fixed when the GEM object is created. Buffer
+	 * objects placed by the driver satisfy any allocation of their size
+	 * that leaves the choice to the driver. Buffer objects are grouped by
+	 * their size class, i.e., the log2 of their size.
+	 */
+	struct Bo_cache
+	{
+		enum { NUM_SIZE_CLASSES = 32 };
+
+		Genode::List<Buffer_object> _classes[NUM_SIZE_CLASSES] { };
+
+		Genode::size_t _bytes { 0 };
+
+		static unsigned _size_class(Genode::size_t size)
+		{
+			unsigned const msb = unsigned(Genode::log2(Genode::max(size, 1UL)));
+			return msb < NUM_SIZE_CLASSES ? msb : NUM_SIZE_CLASSES - 1;
+		}
+
+		void insert(Buffer_object &bo)
+		{
+			_classes[_size_class(bo.size)].insert(&bo);
+			_bytes += bo.size;
+		}
+
+		void remove(Buffer_object &bo)
+		{
+			_classes[_size_class(bo.size)].remove(&bo);
+			_bytes -= bo.size;
+		}
+
+		/* a 'va' of 0 matches buffer objects placed by the driver */
+		Buffer_object *lookup(Genode::uint32_t va, Genode::size_t size)
+		{
+			for (Buffer_object *bo = _classes[_size_class(size)].first();
+			     bo; bo = bo->next())
+				if ((va ? bo->va == va : bo->driver_va) && bo->size == size)
+					return bo;
+
+			return nullptr;
+		}
+
+		template <typename FN>
+		void for_each(FN const &fn)
+		{
+			for (Genode::List<Buffer_object> &list : _classes)
+				for (Buffer_object *bo = list.first(), *next = nullptr; bo; bo = next) {
+					next = bo->next();
+					fn(*bo);
+				}
+		}
+
+		Genode::size_t bytes() const { return _bytes; }
+	};
+
+	Bo_cache _cache { };
+
+	Genode::size_t _cache_limit;
+
+	void _evict(Buffer_object &bo, auto const &close_fn)
+	{
+		_cache.remove(bo);
+		close_fn(bo.handle);
+		Genode::destroy(_alloc, &bo);
+	}
+
+	Buffer_object_space(Genode::Allocator &alloc, Genode::size_t cache_limit)
+	:
+		Handle_table { alloc }, _alloc { alloc }, _cache_limit { cache_limit }
+	{ }
 
 	~Buffer_object_space()
 	{ }
 
+	/**
+	 * Set the amount of memory kept in the cache, applied on the next release
+	 */
+	void cache_limit(Genode::size_t limit) { _cache_limit = limit; }
+
+	/**
+	 * Reuse a cached buffer object for the given allocation
+	 *
+	 * \param va  GPU virtual address or 0, in which case 'va' is set
+	 *            to the address of the reused buffer object
+	 *
+	 * \return true if a matching buffer object was found
+	 */
+	bool reuse(Gpu::Vram_id id, Genode::uint32_t &va, Genode::size_t size)
+	{
+		Buffer_object *bo = _cache.lookup(va, size);
+		if (!bo)
+			return false;
+
+		va = bo->va;
+
+		_cache.remove(*bo);
+		bo->bind(*this, id);
+
+		/*
+		 * A new GEM object is zero-filled and clients may rely on it,
+		 * so clear the previous content and clean it from the cache on
+		 * the next submit
+		 */
+		Genode::memset(bo->attached_ds.local_addr<void>(), 0, bo->attached_ds.size());
+		bo->cpu_unmapped();
+		bo->mark_dirty();
+		return true;
+	}
+
+	/**
+	 * Close cached buffer objects occupying the given GPU virtual range
+	 *
+	 * The client considers the range of a freed buffer as available.
+	 */
+	void evict_overlapping(Genode::uint32_t va, Genode::size_t size,
+	                       auto const &close_fn)
+	{
+		_cache.for_each([&] (Buffer_object &bo) {
+			if (bo.overlaps(va, size))
+				_evict(bo, close_fn); });
+	}
+
+	/**
+	 * Destroy all live and cached buffer objects without closing their
+	 * GEM handles
+	 *
+	 * Used when the DRM file is about to be closed, which releases all
+	 * handles of the file at once.
+	 */
+	void discard_all()
+	{
+		_cache.for_each([&] (Buffer_object &bo) {
+			_cache.remove(bo);
+			Genode::destroy(_alloc, &bo); });
+
+		while (apply_any([&] (Buffer_object &bo) {
+			Genode::destroy(_alloc, &bo); })) { }
+	}
+
+	/**
+	 * Shrink the cache to at most 'limit' bytes
+	 */
+	void trim(Genode::size_t limit, auto const &close_fn)
+	{
+		_cache.for_each([&] (Buffer_object &bo) {
+			if (_cache.bytes() > limit)
+				_evict(bo, close_fn); });
+	}
+
+	/**
+	 * Release buffer object, either by moving it into the cache or by
+	 * closing its GEM handle
+	 *
+	 * \return true if the buffer object was managed
+	 */
+	bool release(Gpu::Vram_id id, bool cacheable, auto const &close_fn)
+	{
+		Buffer_object *bop = nullptr;
+		_try_apply(id, [&] (Buffer_object &b) { bop = &b; });
+
+		if (!bop)
+			return false;
+
+		Buffer_object &bo = *bop;
+
+		if (!cacheable || bo.size > _cache_limit) {
+			close_fn(bo.handle);
+			Genode::destroy(_alloc, &bo);
+			return true;
+		}
+
+		bo.unbind();
+		_cache.insert(bo);
+
+		trim(_cache_limit, close_fn);
+		return true;
+	}
+
 	template <typename FN>
 	void _try_apply(Gpu::Vram_id id, FN const &fn)
 	{
-		try {
-			Genode::Id_space<Buffer_object>::Id buffer_id { .value = id.value };
-			apply<Buffer_object>(buffer_id, fn);
-		} catch (Buffer_object_space::Unknown_id) { }
+		apply(Id { .value = id.value }, fn);
 	}
 
 	void *local_addr(Gpu::Vram_id id)
@@ -280,8 +739,7 @@ struct Buffer_object_space : Genode::Id_space<Buffer_object>
 
 		_try_apply(id, [&] (Buffer_object &b) {
 				if (flush)
-					lx_emul_mem_cache_clean_invalidate(b.attached_ds.local_addr<void>(),
-					                                   b.attached_ds.size());
+					(void)b.flush_dirty();
 				result = { b.handle, true };
 		});
 
@@ -289,11 +747,13 @@ struct Buffer_object_space : Genode::Id_space<Buffer_object>
 	}
 
 	void insert(Gpu::Vram_id id, Genode::uint32_t handle, Genode::uint32_t va,
+	            Genode::size_t size, bool driver_va,
 	            Genode::Dataspace_capability cap, Genode::Env::Local_rm &rm)
 	{
 		// XXX assert id is not assosicated with other handle and
 		//     handle is not already present in registry
-		new (&_alloc) Buffer_object(*this, id, handle, va, cap, rm);
+		new (&_alloc) Buffer_object(*this, id, handle, va, size, driver_va,
+		                            cap, rm);
 	}
 
 	void remove(Gpu::Vram_id id)
@@ -334,6 +794,8 @@ struct Buffer_object_space : Genode::Id_space<Buffer_object>
 		});
 	}
 
+	Genode::size_t cached_bytes() const { return _cache.bytes(); }
+
 	bool managed(Gpu::Vram_id id)
 	{
 		bool result = false;
@@ -360,11 +822,25 @@ struct Vram_owner
 };
 
 
+struct Vram_local;
+
+
+/*
+ * Generation of the buffer-id resolution of all sessions, advanced whenever
+ * a 'Vram_local' appears, vanishes, or changes its resolution, so that the
+ * submit caches of the workers do not refer to stale buffer objects
+ */
+static unsigned _vram_generation = 0;
+
+
 struct Gpu_vram : Genode::Rpc_object<Gpu::Vram>
 {
-	Buffer_object const &bo;
+	Buffer_object       &bo;
 	Vram_owner    const &_owner;
 
+	/* local references that cache the resolved buffer object */
+	Genode::List<Vram_local> _users { };
+
 	struct Import_name
 	{
 		Genode::uint32_t value;
@@ -376,7 +852,7 @@ struct Gpu_vram : Genode::Rpc_object<Gpu::Vram>
 
 	Import_name import_name;
 
-	Gpu_vram(Buffer_object const &bo,
+	Gpu_vram(Buffer_object       &bo,
 	         Vram_owner    const &owner)
 	:
 		bo { bo },
@@ -384,6 +860,8 @@ struct Gpu_vram : Genode::Rpc_object<Gpu::Vram>
 		import_name { 0, false }
 	{ }
 
+	~Gpu_vram();
+
 	bool owner(Genode::Capability<Gpu::Session> other) const
 	{
 		return _owner.cap == other;
@@ -391,12 +869,24 @@ struct Gpu_vram : Genode::Rpc_object<Gpu::Vram>
 };
 
 
-struct Vram_local
+struct Vram_local : Genode::List<Vram_local>::Element
 {
-	Genode::Id_space<Vram_local>::Element const _elem;
+	/*
+	 * Noncopyable
+	 */
+	Vram_local(Vram_local const &) = delete;
+	Vram_local &operator = (Vram_local const &) = delete;
+
+	Gpu::Handle_table<Vram_local>::Element const _elem;
 
 	Gpu::Vram_capability vram_cap;
 
+	/*
+	 * Resolved 'vram_cap', reset by the 'Gpu_vram' on destruction,
+	 * i.e., when the exporting session frees the buffer or exits
+	 */
+	Gpu_vram *_vram { nullptr };
+
 	struct Import_handle
 	{
 		Genode::uint32_t  value;
@@ -416,18 +906,56 @@ struct Vram_local
 	Export_name   export_name   { 0, false };
 	Import_handle import_handle { 0, false };
 
-	Vram_local(Genode::Id_space<Vram_local> &space,
-	           Gpu::Vram_capability          vram_cap,
-	           Gpu::Vram_id                  vram_id)
+	Vram_local(Gpu::Handle_table<Vram_local> &space,
+	           Gpu::Vram_capability           vram_cap,
+	           Gpu::Vram_id                   vram_id)
 	:
 		_elem { *this, space,
-		        Genode::Id_space<Vram_local>::Id { .value = vram_id.value } },
+		        Gpu::Handle_table<Vram_local>::Id { .value = vram_id.value } },
 		vram_cap { vram_cap }
-	{ }
+	{
+		_vram_generation++;
+	}
+
+	~Vram_local()
+	{
+		if (_vram)
+			_vram->_users.remove(this);
+
+		_vram_generation++;
+	}
+
+	template <typename FN>
+	void with_bo(Genode::Entrypoint &ep, FN const &fn)
+	{
+		if (!_vram)
+			ep.rpc_ep().apply(vram_cap, [&] (Gpu_vram *v) {
+				if (!v)
+					return;
+
+				_vram = v;
+				_vram->_users.insert(this);
+				_vram_generation++;
+			});
+
+		if (_vram)
+			fn(_vram->bo);
+	}
 };
 
 
-struct Vram_local_space : Genode::Id_space<Vram_local>
+Gpu_vram::~Gpu_vram()
+{
+	while (Vram_local *vl = _users.first()) {
+		_users.remove(vl);
+		vl->_vram = nullptr;
+	}
+
+	_vram_generation++;
+}
+
+
+struct Vram_local_space : Gpu::Handle_table<Vram_local>
 {
 	Genode::Entrypoint &_ep;
 	Genode::Allocator  &_alloc;
@@ -435,15 +963,12 @@ struct Vram_local_space : Genode::Id_space<Vram_local>
 	template <typename FN>
 	void _try_apply(Gpu::Vram_id id, FN const &fn)
 	{
-		try {
-			Vram_local_space::Id vl_id { .value = id.value };
-			apply<Vram_local>(vl_id, fn);
-		} catch (Vram_local_space::Unknown_id) { }
+		apply(Id { .value = id.value }, fn);
 	}
 
 	Vram_local_space(Genode::Entrypoint &ep,
 	                 Genode::Allocator  &alloc)
-	: _ep { ep }, _alloc { alloc } { }
+	: Handle_table { alloc }, _ep { ep }, _alloc { alloc } { }
 
 	~Vram_local_space()
 	{ }
@@ -509,118 +1034,788 @@ struct Vram_local_space : Genode::Id_space<Vram_local>
 	void with_bo(Gpu::Vram_id id, FN const &fn)
 	{
 		_try_apply(id, [&] (Vram_local &vl) {
-			_ep.rpc_ep().apply(vl.vram_cap, [&] (Gpu_vram *v) {
-				fn(v->bo);
-			});
-		});
+			vl.with_bo(_ep, fn); });
 	}
 };
 
 
-struct Syncobj_notifier : Genode::Interface
+struct Syncobj_notifier : Genode::Interface,
+                          Genode::List<Syncobj_notifier>::Element
 {
+	/* waiting for a record of the fence tracker to become available */
+	bool deferred { false };
+
 	virtual void notify() = 0;
 };
 
 
-struct Gpu::Worker_args
+/*
+ * Statistics of a session, updated by its worker task
+ */
+struct Gpu::Session_stats
 {
-	Env::Local_rm       &rm;
-	Buffer_object_space &buffers;
-	Vram_local_space    &vram_local_space;
+	/*
+	 * Histogram of the latency between submitting a job and the signaling
+	 * of its out-sync object, the first bucket covers latencies below
+	 * 250 us and each following one doubles the range
+	 */
+	enum { LATENCY_BUCKETS = 9, FIRST_BUCKET_US = 250 };
 
-	Syncobj_notifier &_syncobj_notifier;
+	Genode::uint64_t submits;
+	Genode::uint64_t allocs;
+	Genode::uint64_t frees;
+	Genode::uint64_t flushed_bytes;
+	Genode::uint64_t last_submit_bytes;
 
-	struct task_struct *_gpu_task { nullptr };
+	/* submits whose buffer list was resolved by the submit cache */
+	Genode::uint64_t submit_cache_hits;
 
-	Gpu::Request       *_pending_request   { nullptr };
-	Gpu::Request       *_completed_request { nullptr };
-	Gpu::Local_request *_local_request     { nullptr };
+	/* held-back submits that failed when released */
+	Genode::uint64_t failed_submits;
 
-	void *drm { nullptr };
+	/* submitted jobs whose out-sync object is not signaled yet */
+	unsigned in_flight;
 
-	Gpu::Info_lima info { };
+	/* time the GPU spent on jobs of the session */
+	Genode::uint64_t busy_us;
 
-	Worker_args(Env::Local_rm &rm, Buffer_object_space &buffers,
-	            Vram_local_space &vram_local_space,
-	            Syncobj_notifier &notifier)
-	:
-		rm { rm }, buffers { buffers }, vram_local_space { vram_local_space },
-		_syncobj_notifier { notifier }
-	{ }
+	Genode::uint64_t latency[LATENCY_BUCKETS];
 
-	void signal_syncobj_wait(void)
+	static unsigned _bucket(Genode::uint64_t us)
 	{
-		_syncobj_notifier.notify();
+		unsigned i = 0;
+		for (Genode::uint64_t limit = FIRST_BUCKET_US;
+		     i < LATENCY_BUCKETS - 1 && us >= limit; limit *= 2)
+			i++;
+		return i;
 	}
 
-	template <typename FN> void with_local_request(FN const &fn)
+	void submitted(Genode::uint64_t flushed)
 	{
-		if (!_local_request)
-			return;
-
-		fn(*_local_request);
+		submits++;
+		flushed_bytes += flushed;
+		last_submit_bytes = flushed;
 	}
 
-	template <typename FN> void with_pending_request(FN const &fn)
+	void signaled(Genode::uint64_t latency_us, Genode::uint64_t job_us)
 	{
-		if (!_pending_request || !_pending_request->valid() || !_completed_request)
-			return;
+		if (in_flight)
+			in_flight--;
 
-		/*
- 		 * Reset first to prevent _schedule_request from picking up
-		 * unfinished requests, e.g. SYNCOBJ_WAIT.
-		 */
-		*_completed_request = Gpu::Request();
+		busy_us += job_us;
+		latency[_bucket(latency_us)]++;
+	}
 
-		*_completed_request = fn(*_pending_request);
-		*_pending_request   = Gpu::Request();
+	void generate(Genode::Generator &g) const
+	{
+		g.attribute("submits",       submits);
+		g.attribute("in_flight",     in_flight);
+		g.attribute("busy_us",       busy_us);
+		g.attribute("allocs",        allocs);
+		g.attribute("frees",         frees);
+		g.attribute("flushed_bytes", flushed_bytes);
+		g.attribute("submit_cache_hits", submit_cache_hits);
+		g.attribute("failed_submits",    failed_submits);
+
+		Genode::uint64_t limit = FIRST_BUCKET_US;
+		for (unsigned i = 0; i < LATENCY_BUCKETS; i++, limit *= 2)
+			g.node("latency", [&] {
+				if (i < LATENCY_BUCKETS - 1)
+					g.attribute("below_us", limit);
+				else
+					g.attribute("above_us", limit/2);
+				g.attribute("count", latency[i]);
+			});
 	}
 };
 
 
-static int _populate_info(void *drm, Gpu::Info_lima &info)
+static Genode::uint64_t _now_us()
 {
-	for (Gpu::Info_lima::Param &p : info.param)
-		p = 0;
-
-	Genode::uint8_t params[Gpu::Info_lima::MAX_LIMA_PARAMS] = {
-		0x00, /* DRM_LIMA_PARAM_GPU_ID */
-		0x01, /* DRM_LIMA_PARAM_NUM_PP */
-		0x02, /* DRM_LIMA_PARAM_GP_VERSION */
-		0x03, /* DRM_LIMA_PARAM_PP_VERSION */
-	};
-
-	for (int p = 0; p < Gpu::Info_lima::MAX_LIMA_PARAMS; p++) {
-
-		Genode::uint64_t value;
-		int const err = lx_drm_ioctl_lima_gem_param(drm, params[p], &value);
-		if (err)
-			return -1;
-
-		info.param[p] = value;
-	}
-	return 0;
+	return Lx_kit::env().timer.curr_time().trunc_to_plain_us().value;
 }
 
 
-/* implemented in 'lx_user.c' */
-extern "C" struct task_struct *lx_user_task;
-extern "C" void               *lx_user_task_args;
-extern "C" struct task_struct *lx_user_new_gpu_task(int (*func)(void*), void *args);
-extern "C" void                lx_user_destroy_gpu_task(struct task_struct*);
+static Genode::Constructible<Gpu::Job_trace> _job_trace { };
 
 
 /*
- * Function executed by each worker task that handles all
- * request dispatching into the kernel.
+ * Weighted fair share of GPU time between sessions
+ *
+ * The GPU time consumed by the jobs of a session, scaled by the inverse
+ * of its weight, forms the virtual time of the session. A session ahead
+ * of another session with jobs in flight by more than one slice gets
+ * throttled: its submits are held back until the other sessions caught up.
  */
-extern "C" int gpu_task_func(void *p)
+struct Gpu::Fair_share
 {
-	Gpu::Worker_args &args = *static_cast<Gpu::Worker_args*>(p);
+	enum { DEFAULT_WEIGHT = 10 };
 
-	using namespace Genode;
-	using OP = Gpu::Operation::Type;
+	Genode::uint64_t slice_us { 16*1000 };
+
+	struct Client : Genode::List<Client>::Element
+	{
+		Client(Client const &) = delete;
+		Client &operator = (Client const &) = delete;
+
+		Fair_share          &_share;
+		unsigned       const weight;
+		Session_stats const &_stats;
+		Syncobj_notifier    &_notifier;
+
+		/* virtual time a previously idle session joined at */
+		Genode::uint64_t _vtime_base { 0 };
+
+		/* submits are held back */
+		bool _held { false };
+
+		Genode::uint64_t vtime() const {
+			return _vtime_base + _stats.busy_us*DEFAULT_WEIGHT/weight; }
+
+		bool active() const { return _stats.in_flight > 0; }
+
+		Client(Fair_share &share, unsigned weight,
+		       Session_stats const &stats, Syncobj_notifier &notifier)
+		:
+			_share { share }, weight { Genode::max(weight, 1u) },
+			_stats { stats }, _notifier { notifier }
+		{
+			_share._clients.insert(this);
+		}
+
+		~Client()
+		{
+			_share._clients.remove(this);
+			_share.update();
+		}
+	};
+
+	Genode::List<Client> _clients { };
+
+	template <typename FN>
+	void _for_each_other_active(Client const &client, FN const &fn) const
+	{
+		for (Client const *c = _clients.first(); c; c = c->next())
+			if (c != &client && c->active())
+				fn(*c);
+	}
+
+	bool _throttled(Client const &client) const
+	{
+		bool result = false;
+		_for_each_other_active(client, [&] (Client const &c) {
+			if (client.vtime() > c.vtime() + slice_us)
+				result = true; });
+		return result;
+	}
+
+	/**
+	 * Let a previously idle client join at the current virtual time
+	 *
+	 * Called before the client submits a job. This way, a session that
+	 * was idle for a long time cannot monopolize the GPU.
+	 */
+	void activate(Client &client)
+	{
+		if (client.active())
+			return;
+
+		Genode::uint64_t min_vtime = ~0ULL;
+		_for_each_other_active(client, [&] (Client const &c) {
+			min_vtime = Genode::min(min_vtime, c.vtime()); });
+
+		if (min_vtime == ~0ULL || min_vtime < slice_us)
+			return;
+
+		Genode::uint64_t const join = min_vtime - slice_us;
+		if (client.vtime() < join)
+			client._vtime_base += join - client.vtime();
+	}
+
+	/**
+	 * Check whether a submit of the client must be held back
+	 */
+	bool hold(Client &client)
+	{
+		if (_throttled(client))
+			client._held = true;
+
+		return client._held;
+	}
+
+	/**
+	 * Release held back submits, called whenever a job finished
+	 */
+	void update()
+	{
+		for (Client *c = _clients.first(); c; c = c->next())
+			if (c->_held && !_throttled(*c)) {
+				c->_held = false;
+				c->_notifier.notify();
+			}
+	}
+};
+
+
+static Gpu::Fair_share _fair_share { };
+
+
+/*
+ * Pending signal callbacks of sync objects
+ *
+ * A callback is used to measure the latency of a submitted job as well as
+ * to notify a session whose client waits for a sync object. As the callback
+ * may fire after the session is gone, the records are kept driver-wide and
+ * are merely dissociated from a vanishing session. Jobs and notifications
+ * use separate pools of records so that tracked jobs cannot starve the
+ * notifications of waiting clients.
+ */
+struct Gpu::Fence_tracker
+{
+	enum { JOB_CAPACITY = 256, WAIT_CAPACITY = 256 };
+
+	struct Record
+	{
+		Fence_tracker    *tracker;
+		void             *drm;
+		Genode::uint32_t  syncobj;
+		unsigned          pipe;
+		Session_stats    *stats;
+		Syncobj_notifier *notifier;
+		Genode::uint64_t  submit_us;
+		Job_trace::Label_id trace_label;
+		bool              used;
+	};
+
+	Record _job_records [JOB_CAPACITY]  { };
+	Record _wait_records[WAIT_CAPACITY] { };
+
+	/* notifiers for which no wait record was available */
+	Genode::List<Syncobj_notifier> _deferred { };
+
+	/*
+	 * Notify the deferred notifiers once a wait record got available,
+	 * their clients check again and re-arm the notification
+	 */
+	void _wake_deferred()
+	{
+		while (Syncobj_notifier *n = _deferred.first()) {
+			_deferred.remove(n);
+			n->deferred = false;
+			n->notify();
+		}
+	}
+
+	/*
+	 * As each pipe executes one job at a time, a job started no earlier
+	 * than the previous job on the same pipe finished.
+	 */
+	Genode::uint64_t _last_signal_us[Operation::MAX_PIPE] { };
+
+	static void _signaled(void *arg)
+	{
+		Record &r = *static_cast<Record *>(arg);
+
+		/* records used for notifications only carry no submit time */
+		if (r.submit_us) {
+			Genode::uint64_t &last = r.tracker->_last_signal_us[r.pipe];
+			Genode::uint64_t const now   = _now_us();
+			Genode::uint64_t const start = Genode::max(r.submit_us, last);
+
+			last = now;
+
+			if (_job_trace.constructed())
+				_job_trace->gpu_event("job", r.trace_label, r.pipe, start, now);
+
+			if (r.stats) {
+				r.stats->signaled(now - r.submit_us, now - start);
+				_fair_share.update();
+			}
+		}
+
+		Fence_tracker &tracker = *r.tracker;
+		bool const     wait    = !r.submit_us;
+
+		if (r.notifier)
+			r.notifier->notify();
+
+		r = Record { };
+
+		if (wait)
+			tracker._wake_deferred();
+	}
+
+	enum class Arm_result { ARMED, NO_RECORD, NO_FENCE };
+
+	/**
+	 * Register signal callback for the given record
+	 */
+	template <unsigned N>
+	Arm_result _arm(Record (&records)[N], Record const &record)
+	{
+		for (Record &r : records) {
+			if (r.used)
+				continue;
+
+			r = record;
+			r.tracker = this;
+			r.used    = true;
+
+			if (lx_drm_syncobj_signal_callback(r.drm, r.syncobj, _signaled, &r)) {
+				r = Record { };
+				return Arm_result::NO_FENCE;
+			}
+			return Arm_result::ARMED;
+		}
+		return Arm_result::NO_RECORD;
+	}
+
+	/**
+	 * Measure the latency until the given sync object gets signaled
+	 *
+	 * Submits are not measured while all records are in use.
+	 */
+	void track(void *drm, Genode::uint32_t syncobj, unsigned pipe,
+	           Session_stats &stats, Job_trace::Label_id trace_label)
+	{
+		stats.in_flight++;
+
+		Record const record { .tracker = this, .drm = drm, .syncobj = syncobj,
+		                      .pipe = pipe, .stats = &stats, .notifier = nullptr,
+		                      .submit_us = _now_us(), .trace_label = trace_label,
+		                      .used = true };
+
+		if (_arm(_job_records, record) != Arm_result::ARMED)
+			stats.in_flight--;
+	}
+
+	/**
+	 * Notify once the given sync object gets signaled
+	 *
+	 * A notification is armed only once per sync object until it fires.
+	 * If all wait records are in use, the notifier is deferred until one
+	 * of the armed notifications fires and frees its record.
+	 */
+	void notify_on_signal(void *drm, Genode::uint32_t syncobj,
+	                      Syncobj_notifier &notifier)
+	{
+		for (Record const &r : _wait_records)
+			if (r.used && r.notifier == &notifier
+			 && r.drm == drm && r.syncobj == syncobj)
+				return;
+
+		Record const record { .tracker = this, .drm = drm, .syncobj = syncobj,
+		                      .pipe = 0, .stats = nullptr, .notifier = &notifier,
+		                      .submit_us = 0, .trace_label = Job_trace::Label_id::unknown(),
+		                      .used = true };
+
+		switch (_arm(_wait_records, record)) {
+		case Arm_result::ARMED:
+			break;
+
+		/* the fence got detached meanwhile, let the client check again */
+		case Arm_result::NO_FENCE:
+			notifier.notify();
+			break;
+
+		case Arm_result::NO_RECORD:
+			if (!notifier.deferred) {
+				notifier.deferred = true;
+				_deferred.insert(&notifier);
+			}
+			break;
+		}
+	}
+
+	/**
+	 * Return true if a tracked job has not finished yet
+	 */
+	bool jobs_in_flight() const
+	{
+		for (Record const &r : _job_records)
+			if (r.used)
+				return true;
+
+		return false;
+	}
+
+	void dissolve(Session_stats const &stats, Syncobj_notifier &notifier)
+	{
+		for (Record &r : _job_records)
+			if (r.stats == &stats)
+				r.stats = nullptr;
+
+		for (Record &r : _wait_records)
+			if (r.notifier == &notifier)
+				r.notifier = nullptr;
+
+		if (notifier.deferred) {
+			_deferred.remove(&notifier);
+			notifier.deferred = false;
+		}
+	}
+};
+
+
+static Gpu::Fence_tracker _fence_tracker { };
+
+
+struct Gpu::Worker_args
+{
+	Env::Local_rm       &rm;
+	Buffer_object_space &buffers;
+	Vram_local_space    &vram_local_space;
+
+	Syncobj_notifier &_syncobj_notifier;
+
+	struct task_struct *_gpu_task { nullptr };
+
+	Gpu::Request_queue *_requests      { nullptr };
+	Gpu::Local_request *_local_request { nullptr };
+
+	void *drm { nullptr };
+
+	Gpu::Info_lima info { };
+
+	Gpu::Session_stats stats { };
+
+	Gpu::Job_trace::Label_id trace_label { Gpu::Job_trace::Label_id::unknown() };
+
+	/* resolved buffer lists of recent submits */
+	Gpu::Submit_cache<Buffer_object> submit_cache;
+
+	/*
+	 * Sync objects receiving the fences of exported buffers named by the
+	 * in-sync entries of a submit, created on first use
+	 */
+	Genode::uint32_t vram_fence_syncobj[2] { 0, 0 };
+
+	/*
+	 * Exported buffers of the session used by the current submit, the
+	 * array grows to the largest buffer count of a submit
+	 */
+	struct Fenced_bos
+	{
+		/*
+		 * Noncopyable
+		 */
+		Fenced_bos(Fenced_bos const &) = delete;
+		Fenced_bos &operator = (Fenced_bos const &) = delete;
+
+		Genode::Allocator &_alloc;
+
+		Buffer_object **_bos      { nullptr };
+		unsigned        _capacity { 0 };
+
+		unsigned count { 0 };
+
+		Fenced_bos(Genode::Allocator &alloc) : _alloc { alloc } { }
+
+		~Fenced_bos()
+		{
+			if (_bos)
+				_alloc.free(_bos, sizeof(Buffer_object *)*_capacity);
+		}
+
+		/**
+		 * Prepare for a submit with 'nr_bos' buffers
+		 *
+		 * \return false if the array could not be grown
+		 */
+		bool reset(unsigned nr_bos)
+		{
+			count = 0;
+
+			if (nr_bos <= _capacity)
+				return true;
+
+			if (_bos)
+				_alloc.free(_bos, sizeof(Buffer_object *)*_capacity);
+
+			_bos      = nullptr;
+			_capacity = 0;
+
+			try {
+				_bos      = new (_alloc) Buffer_object*[nr_bos];
+				_capacity = nr_bos;
+			} catch (...) { return false; }
+
+			return true;
+		}
+
+		void add(Buffer_object &obj)
+		{
+			if (count < _capacity)
+				_bos[count++] = &obj;
+		}
+
+		template <typename FN>
+		void for_each(FN const &fn) const
+		{
+			for (unsigned i = 0; i < count; i++)
+				fn(*_bos[i]);
+		}
+	} fenced_bos;
+
+	Worker_args(Env::Local_rm &rm, Genode::Allocator &alloc,
+	            Buffer_object_space &buffers,
+	            Vram_local_space &vram_local_space,
+	            Syncobj_notifier &notifier)
+	:
+		rm { rm }, buffers { buffers }, vram_local_space { vram_local_space },
+		_syncobj_notifier { notifier }, submit_cache { alloc },
+		fenced_bos { alloc }
+	{ }
+
+	void signal_syncobj_wait(void)
+	{
+		_syncobj_notifier.notify();
+	}
+
+	template <typename FN> void with_local_request(FN const &fn)
+	{
+		if (!_local_request)
+			return;
+
+		fn(*_local_request);
+	}
+
+	template <typename FN> void drain_requests(FN const &fn)
+	{
+		if (_requests)
+			_requests->drain(fn);
+	}
+};
+
+
+static int _populate_info(void *drm, Gpu::Info_lima &info)
+{
+	for (Gpu::Info_lima::Param &p : info.param)
+		p = 0;
+
+	Genode::uint8_t params[Gpu::Info_lima::MAX_LIMA_PARAMS] = {
+		0x00, /* DRM_LIMA_PARAM_GPU_ID */
+		0x01, /* DRM_LIMA_PARAM_NUM_PP */
+		0x02, /* DRM_LIMA_PARAM_GP_VERSION */
+		0x03, /* DRM_LIMA_PARAM_PP_VERSION */
+	};
+
+	for (int p = 0; p < Gpu::Info_lima::MAX_LIMA_PARAMS; p++) {
+
+		Genode::uint64_t value;
+		int const err = lx_drm_ioctl_lima_gem_param(drm, params[p], &value);
+		if (err)
+			return -1;
+
+		info.param[p] = value;
+	}
+	return 0;
+}
+
+
+/*
+ * Suspend the GPU after a period without submits
+ *
+ * Suspending and resuming is performed by the power-management functions
+ * of the lima kernel driver, which save and quiesce the state of the GP,
+ * PP, and MMU units. The GPU clocks stay enabled as the clock emulation
+ * cannot gate them. The GPU is resumed by the worker task of the session
+ * that submits the next job.
+ */
+struct Gpu::Runtime_pm
+{
+	Genode::uint64_t const _timeout_us;
+
+	/* re-armed on each submit */
+	Timer::One_shot_timeout<Runtime_pm> _idle_timeout;
+
+	void _handle_idle_timeout(Genode::Duration);
+
+	bool _suspended { false };
+
+	Genode::uint64_t _suspended_us { 0 };
+
+	struct Stats
+	{
+		unsigned         suspends;
+		Genode::uint64_t resume_us_last;
+		Genode::uint64_t resume_us_max;
+		Genode::uint64_t suspended_us;
+	} _stats { };
+
+	Runtime_pm(Genode::uint64_t timeout_us)
+	:
+		_timeout_us   { timeout_us },
+		_idle_timeout { Lx_kit::env().timer, *this,
+		                &Runtime_pm::_handle_idle_timeout }
+	{
+		_idle_timeout.schedule(Genode::Microseconds { _timeout_us });
+	}
+
+	/**
+	 * Resume the GPU if needed, called by a worker task before submitting
+	 */
+	void submit()
+	{
+		_idle_timeout.schedule(Genode::Microseconds { _timeout_us });
+
+		if (!_suspended)
+			return;
+
+		Genode::uint64_t const now_us = _now_us();
+
+		int const err = lx_drm_gpu_resume();
+		if (err)
+			Genode::error("lx_drm_gpu_resume failed: ", err);
+
+		Genode::uint64_t const resume_us = _now_us() - now_us;
+
+		_stats.resume_us_last = resume_us;
+		_stats.resume_us_max  = Genode::max(_stats.resume_us_max, resume_us);
+		_stats.suspended_us  += now_us - _suspended_us;
+
+		_suspended = false;
+	}
+
+	void generate(Genode::Generator &g) const
+	{
+		g.attribute("state", _suspended ? "suspended" : "active");
+		g.attribute("suspends",       _stats.suspends);
+		g.attribute("suspended_us",   _stats.suspended_us);
+		g.attribute("resume_us_last", _stats.resume_us_last);
+		g.attribute("resume_us_max",  _stats.resume_us_max);
+	}
+};
+
+
+static Genode::Constructible<Gpu::Runtime_pm> _runtime_pm { };
+
+
+/*
+ * Pool of DRM files prepared for new sessions
+ *
+ * Opening the DRM file and creating the context and the sync objects of a
+ * session is done in advance by the 'lx_user' task. A new session merely
+ * claims a prepared file, which is replaced in the background afterwards.
+ */
+struct Gpu::Drm_pool
+{
+	enum { MAX_FILES = 8 };
+
+	struct File
+	{
+		void       *drm;
+		Ctx_id      ctx_id;
+		Syncobj_id  sync_id[Operation::MAX_PIPE];
+		Info_lima   info;
+	};
+
+	unsigned const _target;
+
+	File     _files[MAX_FILES] { };
+	unsigned _count { 0 };
+
+	Genode::uint64_t _claimed { 0 };
+	Genode::uint64_t _missed  { 0 };
+
+	Genode::Signal_handler<Drm_pool> _refill_handler;
+
+	/* implemented after the 'lx_user' task */
+	void _handle_refill();
+
+	Drm_pool(Genode::Entrypoint &ep, unsigned target)
+	:
+		_target         { Genode::min(target, unsigned(MAX_FILES)) },
+		_refill_handler { ep, *this, &Drm_pool::_handle_refill }
+	{ }
+
+	void refill() { _refill_handler.local_submit(); }
+
+	/**
+	 * Prepare files up to the target, called by the 'lx_user' task
+	 *
+	 * A file is added to the pool only when completely prepared as the
+	 * task may block, in which case files may be claimed meanwhile.
+	 */
+	void fill()
+	{
+		while (_count < _target) {
+
+			File file { };
+
+			file.drm = lx_drm_open();
+			if (!file.drm)
+				return;
+
+			unsigned ctx_id = 0, sync_id[Operation::MAX_PIPE] { };
+
+			bool const ok = !lx_drm_ioctl_lima_ctx_create(file.drm, &ctx_id)
+			             && !lx_drm_ioctl_syncobj_create(file.drm, &sync_id[0])
+			             && !lx_drm_ioctl_syncobj_create(file.drm, &sync_id[1])
+			             && !_populate_info(file.drm, file.info);
+			if (!ok) {
+				Genode::warning("could not prepare DRM file for pool");
+				lx_drm_close(file.drm);
+				return;
+			}
+
+			file.ctx_id     = { ctx_id };
+			file.sync_id[0] = { sync_id[0] };
+			file.sync_id[1] = { sync_id[1] };
+
+			_files[_count++] = file;
+		}
+	}
+
+	/**
+	 * Take a prepared file
+	 *
+	 * \return false if the pool is empty
+	 */
+	bool claim(File &file)
+	{
+		refill();
+
+		if (!_count) {
+			_missed++;
+			return false;
+		}
+
+		file = _files[--_count];
+		_claimed++;
+		return true;
+	}
+
+	void generate(Genode::Generator &g) const
+	{
+		g.attribute("available", _count);
+		g.attribute("target",    _target);
+		g.attribute("claimed",   _claimed);
+		g.attribute("missed",    _missed);
+	}
+};
+
+
+static Genode::Constructible<Gpu::Drm_pool> _drm_pool { };
+
+
+/* implemented in 'lx_user.c' */
+extern "C" struct task_struct *lx_user_task;
+extern "C" void               *lx_user_task_args;
+extern "C" struct task_struct *lx_user_new_gpu_task(int (*func)(void*), void *args);
+extern "C" void                lx_user_destroy_gpu_task(struct task_struct*);
+
+
+/*
+ * Function executed by each worker task that handles all
+ * request dispatching into the kernel.
+ */
+extern "C" int gpu_task_func(void *p)
+{
+	Gpu::Worker_args &args = *static_cast<Gpu::Worker_args*>(p);
+
+	using namespace Genode;
+	using OP = Gpu::Operation::Type;
 
 	while (true) {
 
@@ -656,6 +1851,12 @@ extern "C" int gpu_task_func(void *p)
 				break;
 			case Gpu::Local_request::Type::CLOSE:
 				if (args.drm) {
+					/*
+					 * Closing the DRM file releases all GEM handles, the
+					 * contexts, and the sync objects of the session in
+					 * one pass.
+					 */
+					buffers.discard_all();
 					lx_drm_close(args.drm);
 					args.drm = nullptr;
 					destroy_task = true;
@@ -671,9 +1872,12 @@ extern "C" int gpu_task_func(void *p)
 		if (destroy_task)
 			break;
 
-		/* handle pending request */
+		/* handle all queued requests in one batch */
 		bool notify_client = false;
 
+		auto close_handle = [&] (uint32_t const handle) {
+			(void)lx_drm_gem_close(args.drm, handle); };
+
 		auto dispatch_pending = [&] (Gpu::Request r) {
 
 			/* clear request result */
@@ -694,19 +1898,6 @@ extern "C" int gpu_task_func(void *p)
 				r.success = true;
 				break;
 			}
-			case OP::CTX_FREE:
-			{
-				unsigned int const id = r.operation.ctx_id.value;
-				int err =
-					lx_drm_ioctl_lima_ctx_free(args.drm, id);
-				if (err) {
-					error("lx_drm_ioctl_lima_ctx_free failed: ", err);
-					break;
-				}
-
-				r.success = true;
-				break;
-			}
 			case OP::SYNCOBJ_CREATE:
 			{
 				unsigned int handle;
@@ -723,36 +1914,37 @@ extern "C" int gpu_task_func(void *p)
 				r.success = true;
 				break;
 			}
-			case OP::SYNCOBJ_DESTROY:
-			{
-				unsigned int const handle = r.operation.syncobj_id[0].value;
-				int err =
-					lx_drm_ioctl_syncobj_destroy(args.drm, handle);
-				if (err) {
-					error("lx_drm_ioctl_syncobj_destroy failed: ", err);
-					break;
-				}
-
-				r.success = true;
-				break;
-			}
 			case OP::SYNCOBJ_WAIT:
 			{
-				unsigned int  const handle = r.operation.syncobj_id[0].value;
+				unsigned int handles[Gpu::Operation::MAX_PIPE] { };
+				unsigned int count = 0;
+				for (Gpu::Syncobj_id const id : r.operation.syncobj_id)
+					if (id.value)
+						handles[count++] = id.value;
 
-				/* results < 0 denotes errors, == 0 success and > 0 timeouts */
-				int err =
-					lx_drm_ioctl_syncobj_wait(args.drm, handle);
+				bool const wait_all = r.operation.op == Gpu::Operation::WAIT_ALL;
 
-				notify_client = true;
+				/*
+				 * The sync objects are only polled. Instead of parking the
+				 * worker, the client gets notified via the completion
+				 * signal once a sync object is signaled and checks again.
+				 *
+				 * results < 0 denotes errors, == 0 success and > 0 timeouts
+				 */
+				int err =
+					lx_drm_ioctl_syncobj_wait(args.drm, handles, count, wait_all);
 
 				if (err < 0) {
-					error("lx_drm_ioctl_syncobj_wait ", handle, " failed: ", err);
+					error("lx_drm_ioctl_syncobj_wait ", handles[0], " failed: ", err);
 					break;
 				}
 
-				if (err > 0)
+				if (err > 0) {
+					for (unsigned i = 0; i < count; i++)
+						_fence_tracker.notify_on_signal(args.drm, handles[i],
+						                                args._syncobj_notifier);
 					break;
+				}
 
 				r.success = true;
 				break;
@@ -763,8 +1955,34 @@ extern "C" int gpu_task_func(void *p)
 				uint32_t va = r.operation.va;
 				uint32_t handle;
 
+				/* the kernel's VM picks the address if none is given */
+				bool const driver_va = (va == 0);
+
+				/*
+				 * Checked here rather than by the session as a deferred
+				 * FREE of the same id might still be queued.
+				 */
+				if (buffers.managed(r.operation.id)) {
+					error("Duplicate 'map_gpu' called for ", r.operation.id.value);
+					break;
+				}
+
+				if (buffers.reuse(r.operation.id, va, size)) {
+					r.operation.va = va;
+					args.stats.allocs++;
+					r.success = true;
+					break;
+				}
+
+				if (!driver_va)
+					buffers.evict_overlapping(va, size, close_handle);
+
 				int err =
 					lx_drm_ioctl_lima_gem_create(args.drm, va, size, &handle);
+				if (err && buffers.cached_bytes()) {
+					buffers.trim(0, close_handle);
+					err = lx_drm_ioctl_lima_gem_create(args.drm, va, size, &handle);
+				}
 				if (err) {
 					error("lx_drm_ioctl_lima_gem_create failed: ", err);
 					break;
@@ -779,7 +1997,7 @@ extern "C" int gpu_task_func(void *p)
 					break;
 				}
 
-				if (va != va_allocated) {
+				if (!driver_va && va != va_allocated) {
 					error("va wrong ", Hex(va), " != ", Hex(va_allocated));
 					lx_drm_gem_close(args.drm, handle);
 					break;
@@ -787,8 +2005,12 @@ extern "C" int gpu_task_func(void *p)
 
 				Dataspace_capability cap =
 					genode_lookup_cap(args.drm, offset, size);
-				buffers.insert(r.operation.id, handle, va, cap, rm);
+				buffers.insert(r.operation.id, handle, va_allocated, size,
+				               driver_va, cap, rm);
 
+				r.operation.va = va_allocated;
+
+				args.stats.allocs++;
 				r.success = true;
 				break;
 			}
@@ -825,13 +2047,18 @@ extern "C" int gpu_task_func(void *p)
 			{
 				uint32_t name;
 
-				buffers.with_handle(r.operation.id, [&] (uint32_t const handle) {
-					int const err = lx_drm_gem_flink(args.drm, handle, &name);
+				buffers.with_bo(r.operation.id, [&] (Buffer_object &bo) {
+					int const err = lx_drm_gem_flink(args.drm, bo.handle, &name);
 					if (err) {
 						error("lx_drm_gem_flink failed: ", err);
 						return;
 					}
 
+					/* importers may depend on the jobs using the buffer */
+					if (!bo.fence_syncobj
+					 && !lx_drm_ioctl_syncobj_create(args.drm, &bo.fence_syncobj))
+						bo.fence_drm = args.drm;
+
 					r.operation.name = name;
 
 					r.success = true;
@@ -840,30 +2067,87 @@ extern "C" int gpu_task_func(void *p)
 			}
 			case OP::FREE:
 			{
-				bool bo_found = false;
-				buffers.with_handle(r.operation.id, [&] (uint32_t const handle) {
-					(void)lx_drm_gem_close(args.drm, handle);
-					bo_found = true;
-				});
+				/*
+				 * Exported buffer objects, denoted by their global name,
+				 * may still be in use by other sessions and are never
+				 * cached.
+				 */
+				bool const exported = r.operation.handle != 0;
+
+				if (exported)
+					buffers.with_bo(r.operation.id, [&] (Buffer_object &bo) {
+						if (bo.fence_syncobj)
+							(void)lx_drm_ioctl_syncobj_destroy(args.drm,
+							                                   bo.fence_syncobj);
+						bo.fence_syncobj = 0;
+						bo.fence_drm     = nullptr;
+					});
 
-				if (bo_found) {
-					buffers.remove(r.operation.id);
+				if (buffers.release(r.operation.id, !exported, close_handle)) {
+					args.stats.frees++;
 					r.success = true;
 				}
 				break;
 			}
+			case OP::TRIM:
+			{
+				buffers.trim(r.operation.size, close_handle);
+				r.success = true;
+				break;
+			}
 			case OP::EXEC:
 			{
-				void *gem_submit = nullptr;
-				vram_local_space.with_bo(r.operation.id, [&] (Buffer_object const &bo) {
-					gem_submit = const_cast<void*>(bo.attached_ds.local_addr<void>());
-				});
+				void *gem_submit = r.operation.submit;
+				if (!gem_submit)
+					vram_local_space.with_bo(r.operation.id, [&] (Buffer_object const &bo) {
+						gem_submit = const_cast<void*>(bo.attached_ds.local_addr<void>());
+					});
 				if (!gem_submit)
 					break;
 
 				int err = 0;
+				uint64_t flushed = 0;
 				unsigned nr_bos = lx_drm_gem_submit_bo_count(gem_submit);
-				for (unsigned i = 0; i < nr_bos; i++) {
+
+				if (!args.fenced_bos.reset(nr_bos)) {
+					error("could not allocate list of exported buffers for ",
+					      nr_bos, " buffers");
+					break;
+				}
+
+				auto collect_fenced = [&] (Buffer_object *obj) {
+					if (obj && obj->fence_syncobj && obj->fence_drm == args.drm)
+						args.fenced_bos.add(*obj);
+				};
+
+				using Submit_cache = Gpu::Submit_cache<Buffer_object>;
+
+				Submit_cache::Entry const *cached =
+					args.submit_cache.lookup(_vram_generation, nr_bos,
+						[&] (unsigned i) -> Submit_cache::Key {
+							unsigned const *bo_handle =
+								lx_drm_gem_submit_bo_handle(gem_submit, i);
+							return { .id   = bo_handle ? *bo_handle : 0,
+							         .read = lx_drm_gem_submit_bo_read(gem_submit, i) };
+						});
+
+				if (cached) {
+					args.stats.submit_cache_hits++;
+
+					/* the resolved list is still valid, skip the lookups */
+					for (unsigned i = 0; i < nr_bos; i++) {
+						Submit_cache::Entry const &e = cached[i];
+						if (e.key.read && e.obj)
+							flushed += e.obj->flush_dirty();
+						collect_fenced(e.obj);
+						*lx_drm_gem_submit_bo_handle(gem_submit, i) = e.handle;
+					}
+				}
+
+				Submit_cache::Entry *resolved =
+					cached ? nullptr : args.submit_cache.prepare(nr_bos);
+
+				for (unsigned i = 0; !cached && i < nr_bos; i++) {
 					unsigned *bo_handle = lx_drm_gem_submit_bo_handle(gem_submit, i);
 					bool const bo_read  = lx_drm_gem_submit_bo_read(gem_submit, i);
 					if (!bo_handle) {
@@ -873,11 +2157,12 @@ extern "C" int gpu_task_func(void *p)
 						break;
 					}
 					Gpu::Vram_id id { .value = *bo_handle };
-					/* flush only when read by the GPU */
-					vram_local_space.with_bo(id, [&] (Buffer_object const &bo) {
+					Buffer_object *obj = nullptr;
+					/* flush only the dirty range when read by the GPU */
+					vram_local_space.with_bo(id, [&] (Buffer_object &bo) {
+						obj = &bo;
 						if (bo_read)
-							lx_emul_mem_cache_clean_invalidate(bo.attached_ds.local_addr<void>(),
-							                                   bo.attached_ds.size());
+							flushed += bo.flush_dirty();
 					});
 					Vram_local::Import_handle const handle = vram_local_space.lookup_import(id);
 					if (!handle.valid()) {
@@ -885,18 +2170,62 @@ extern "C" int gpu_task_func(void *p)
 						err = -1;
 						break;
 					}
+					if (resolved)
+						resolved[i] = { .key    = { .id = id.value, .read = bo_read },
+						                .obj    = obj,
+						                .handle = handle.value };
+
+					collect_fenced(obj);
+
 					/* replace client-local buffer id with kernel-local handle */
 					*bo_handle = handle.value;
 				}
 
+				if (resolved && !err)
+					args.submit_cache.commit(_vram_generation);
+
+				/*
+				 * Replace in-sync entries naming a buffer by a sync object
+				 * holding the fence of the buffer. If the buffer carries
+				 * no fence, the job does not depend on it.
+				 */
+				for (unsigned i = 0; !err; i++) {
+					unsigned *in_sync = lx_drm_gem_submit_in_sync(gem_submit, i);
+					if (!in_sync || i >= Gpu::Operation::MAX_PIPE)
+						break;
+
+					if (!(*in_sync & Gpu::In_sync::VRAM_FENCE))
+						continue;
+
+					Gpu::Vram_id const id { .value = *in_sync & ~Gpu::In_sync::VRAM_FENCE };
+					uint32_t &syncobj = args.vram_fence_syncobj[i];
+
+					*in_sync = 0;
+					vram_local_space.with_bo(id, [&] (Buffer_object &bo) {
+						if (!bo.fence_syncobj)
+							return;
+
+						if (!syncobj && lx_drm_ioctl_syncobj_create(args.drm, &syncobj))
+							return;
+
+						if (!lx_drm_syncobj_transfer(bo.fence_drm, bo.fence_syncobj,
+						                             args.drm, syncobj))
+							*in_sync = syncobj;
+					});
+				}
+
 				/* replace context id */
 				lx_drm_gem_submit_ctx_id(gem_submit, r.operation.ctx_id.value);
 
+				if (_runtime_pm.constructed())
+					_runtime_pm->submit();
+
 				/* replace out_sync id */
 				unsigned int const pipe = lx_drm_gem_submit_pipe(gem_submit);
 				if (pipe >= Gpu::Operation::MAX_PIPE)
 					break;
-				lx_drm_gem_submit_set_out_sync(gem_submit, r.operation.syncobj_id[pipe].value);
+				uint32_t const out_sync = r.operation.syncobj_id[pipe].value;
+				lx_drm_gem_submit_set_out_sync(gem_submit, out_sync);
 
 				if (!err)
 					err = lx_drm_ioctl_lima_gem_submit(args.drm,
@@ -910,6 +2239,15 @@ extern "C" int gpu_task_func(void *p)
 					lx_drm_gem_submit_out_sync(gem_submit);
 				r.success = true;
 
+				/* let importers of the used buffers depend on the job */
+				args.fenced_bos.for_each([&] (Buffer_object const &bo) {
+					(void)lx_drm_syncobj_transfer(args.drm, out_sync, args.drm,
+					                              bo.fence_syncobj); });
+
+				args.stats.submitted(flushed);
+				_fence_tracker.track(args.drm, out_sync, pipe, args.stats,
+				                     args.trace_label);
+
 				break;
 			}
 			case OP::WAIT:
@@ -933,7 +2271,33 @@ extern "C" int gpu_task_func(void *p)
 			return r;
 		};
 
-		args.with_pending_request(dispatch_pending);
+		auto dispatch_traced = [&] (Gpu::Request r) {
+
+			if (!_job_trace.constructed())
+				return dispatch_pending(r);
+
+			Genode::uint64_t const begin_us = _now_us();
+			r = dispatch_pending(r);
+
+			using Type = Gpu::Operation::Type;
+			Type const type = r.operation.type;
+			if (type != Type::CTX_CREATE && type != Type::ALLOC
+			 && type != Type::EXEC       && type != Type::WAIT)
+				return r;
+
+			/* the sequence number of a submit is the out-sync of its pipe */
+			unsigned pipe = Gpu::Job_trace::NO_PIPE;
+			if (type == Type::EXEC && r.success)
+				pipe = (r.operation.seqno.value == r.operation.syncobj_id[1].value)
+				     ? 1 : 0;
+
+			_job_trace->session_event(Gpu::Operation::type_name(type),
+			                          args.trace_label, Gpu::Job_trace::WORKER,
+			                          pipe, begin_us, _now_us());
+			return r;
+		};
+
+		args.drain_requests(dispatch_traced);
 
 		if (notify_client)
 			args.signal_syncobj_wait();
@@ -948,7 +2312,8 @@ extern "C" int gpu_task_func(void *p)
 
 /**
  * Function executed by the the 'lx_user' task solely used to
- * create new GPU worker tasks.
+ * create new GPU worker tasks, to suspend the GPU, and to fill
+ * the pool of DRM files.
  */
 struct Lx_user_task_args
 {
@@ -956,6 +2321,11 @@ struct Lx_user_task_args
 	void *args;
 
 	struct task_struct *new_gpu_task;
+
+	bool suspend_gpu;
+	int  suspend_result;
+
+	bool fill_pool;
 };
 static Lx_user_task_args _lx_user_task_args { };
 
@@ -970,6 +2340,16 @@ extern "C" int lx_user_task_func(void *p)
 			args.create_task = false;
 		}
 
+		if (args.suspend_gpu) {
+			args.suspend_result = lx_drm_gpu_suspend();
+			args.suspend_gpu = false;
+		}
+
+		if (args.fill_pool) {
+			_drm_pool->fill();
+			args.fill_pool = false;
+		}
+
 		lx_emul_task_schedule(true);
 	}
 }
@@ -995,6 +2375,46 @@ static struct task_struct *create_gpu_task(void *args)
 }
 
 
+void Gpu::Drm_pool::_handle_refill()
+{
+	if (_count >= _target || _lx_user_task_args.fill_pool)
+		return;
+
+	_lx_user_task_args.fill_pool = true;
+
+	lx_emul_task_unblock(lx_user_task);
+	Lx_kit::env().scheduler.execute();
+}
+
+
+void Gpu::Runtime_pm::_handle_idle_timeout(Genode::Duration)
+{
+	if (_suspended)
+		return;
+
+	/* the GPU is idle not before the last job finished */
+	if (_fence_tracker.jobs_in_flight()) {
+		_idle_timeout.schedule(Genode::Microseconds { _timeout_us });
+		return;
+	}
+
+	/* the kernel driver refuses to suspend while jobs are executed */
+	_lx_user_task_args.suspend_gpu = true;
+
+	lx_emul_task_unblock(lx_user_task);
+	Lx_kit::env().scheduler.execute();
+
+	if (_lx_user_task_args.suspend_result) {
+		_idle_timeout.schedule(Genode::Microseconds { _timeout_us });
+		return;
+	}
+
+	_suspended    = true;
+	_suspended_us = _now_us();
+	_stats.suspends++;
+}
+
+
 struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 {
 	private:
@@ -1005,38 +2425,193 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 		Genode::Env        &_env;
 		Genode::Entrypoint &_ep;
 
-		Vram_owner _owner { cap() };
+		Gpu::Config const _config;
+
+		/*
+		 * RAM donated by the client, which bounds the buffer-object cache
+		 * of the session as the cached buffers are charged to the driver
+		 */
+		Genode::size_t _donated_ram;
+
+		void _update_cache_limit()
+		{
+			_worker_buffers.cache_limit(Genode::min(_config.bo_cache, _donated_ram));
+		}
+
+		Vram_owner _owner { cap() };
+
+		Genode::Heap         _heap   { _env.ram(), _env.rm() };
+		Buffer_object_space  _worker_buffers { _heap, _config.bo_cache };
+
+		Vram_local_space _vram_local_space { _ep, _heap };
+
+		Genode::Id_space<Session_component>::Element const _elem;
+
+		Genode::Attached_ram_dataspace _info_dataspace {
+			_env.ram(), _env.rm(), 4096 };
+
+		static_assert(sizeof(Gpu::Info_lima) <= Gpu::Va_info::OFFSET);
+
+		Gpu::Va_info &_va_info()
+		{
+			return *reinterpret_cast<Gpu::Va_info *>(
+				_info_dataspace.local_addr<char>() + Gpu::Va_info::OFFSET);
+		}
+		Genode::Signal_context_capability _completion_sigh { };
+
+		Gpu::Request_queue _requests { };
+
+		Gpu::Worker_args  _lx_task_args;
+		task_struct      *_lx_task;
+
+		Gpu::Fair_share::Client _share;
+
+		Genode::uint64_t _wait_begin_us { 0 };
+
+		bool _managed_id(Gpu::Request const &request)
+		{
+			using OP = Gpu::Operation::Type;
+
+			switch (request.operation.type) {
+			case OP::FREE:  [[fallthrough]];
+			case OP::EXEC:
+				return _lx_task_args.buffers.managed(request.operation.id);
+			default:
+				break;
+			}
+
+			return true;
+		}
+
+		static bool _blocking(Gpu::Request const &request)
+		{
+			using OP = Gpu::Operation::Type;
+
+			return request.operation.type == OP::WAIT;
+		}
+
+		void _execute_worker()
+		{
+			lx_emul_task_unblock(_lx_task);
+			Lx_kit::env().scheduler.execute();
+		}
+
+		/*
+		 * Submits held back by the fair share of GPU time
+		 *
+		 * As the client may reuse the buffer of a submit right away, the
+		 * submit arguments are copied. The held submits are released in
+		 * order once the session is no longer throttled, or before a
+		 * request that depends on the jobs, e.g. waiting for a buffer, and
+		 * before any buffer handle referenced by a submit is invalidated.
+		 * If too many submits are held, all are released.
+		 */
+		enum { MAX_HELD_EXECS = 16 };
+
+		struct Held_exec
+		{
+			Gpu::Request   request;
+			Genode::size_t size;
+		};
+
+		Held_exec _held_execs[MAX_HELD_EXECS] { };
+		unsigned  _num_held_execs { 0 };
+
+		static bool _depends_on_execs(Gpu::Request const &request)
+		{
+			using OP = Gpu::Operation::Type;
+
+			switch (request.operation.type) {
+			case OP::FREE:  [[fallthrough]];
+			case OP::CLOSE: [[fallthrough]];
+			case OP::WAIT:  [[fallthrough]];
+			case OP::FLINK:
+				return true;
+			default:
+				break;
+			}
+			return false;
+		}
+
+		/**
+		 * Hold back a submit
+		 *
+		 * \return false if the submit could not be held
+		 */
+		bool _hold_exec(Gpu::Request r, Gpu::Sequence_number &seqno)
+		{
+			if (_num_held_execs == MAX_HELD_EXECS)
+				return false;
+
+			char          *copy = nullptr;
+			Genode::size_t size = 0;
+
+			_worker_buffers.with_bo(r.operation.id, [&] (Buffer_object &bo) {
+				try {
+					size = bo.attached_ds.size();
+					copy = new (_heap) char[size];
+					Genode::memcpy(copy, bo.attached_ds.local_addr<char>(), size);
+				} catch (...) { copy = nullptr; }
+			});
+
+			if (!copy)
+				return false;
+
+			unsigned const pipe = lx_drm_gem_submit_pipe(copy);
+			if (pipe >= Gpu::Operation::MAX_PIPE) {
+				_heap.free(copy, size);
+				return false;
+			}
+
+			r.operation.submit = copy;
+			_held_execs[_num_held_execs++] = { .request = r, .size = size };
 
-		Genode::Heap         _heap   { _env.ram(), _env.rm() };
-		Buffer_object_space  _worker_buffers { _heap };
+			/* the worker sets the out-sync object of the pipe on submit */
+			seqno = Gpu::Sequence_number { .value = _sync_id[pipe].value };
+			return true;
+		}
 
-		Vram_local_space _vram_local_space { _ep, _heap };
+		Gpu::Sequence_number _submit_exec(Gpu::Request const &r)
+		{
+			Gpu::Sequence_number seqno { .value = 0 };
 
-		Genode::Id_space<Session_component>::Element const _elem;
+			auto success = [&] (Gpu::Request const &request) {
+				seqno = request.operation.seqno;
+			};
+			auto fail = [&] () { };
+			_schedule_request(r, success, fail);
 
-		Genode::Attached_ram_dataspace _info_dataspace {
-			_env.ram(), _env.rm(), 4096 };
-		Genode::Signal_context_capability _completion_sigh { };
+			return seqno;
+		}
 
-		Gpu::Request _pending_request   { };
-		Gpu::Request _completed_request { };
+		void _release_held_execs()
+		{
+			if (!_num_held_execs)
+				return;
 
-		Gpu::Worker_args  _lx_task_args;
-		task_struct      *_lx_task;
+			/* the worker takes the submits once the pending request finished */
+			while (_requests.worker_blocked())
+				_ep.wait_and_dispatch_one_io_signal();
 
-		bool _managed_id(Gpu::Request const &request)
-		{
-			using OP = Gpu::Operation::Type;
+			for (unsigned i = 0; i < _num_held_execs; i++) {
+				Held_exec &h = _held_execs[i];
 
-			switch (request.operation.type) {
-			case OP::FREE:  [[fallthrough]];
-			case OP::EXEC:
-				return _lx_task_args.buffers.managed(request.operation.id);
-			default:
-				break;
+				/*
+				 * The sync object of the pipe still carries the fence of
+				 * the preceding job. Hence, the client sees the failed
+				 * submit completed once that job finished.
+				 */
+				if (!_submit_exec(h.request).value) {
+					Genode::error("held back submit failed");
+					_lx_task_args.stats.failed_submits++;
+				}
+
+				_heap.free(h.request.operation.submit, h.size);
 			}
+			_num_held_execs = 0;
 
-			return true;
+			/* the client may wait for a held submit */
+			submit_completion_signal();
 		}
 
 		template <typename SUCC_FN, typename FAIL_FN>
@@ -1044,10 +2619,13 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 		                       SUCC_FN const &succ_fn,
 		                       FAIL_FN const &fail_fn)
 		{
-			if (_pending_request.valid()) {
+			if (_depends_on_execs(request))
+				_release_held_execs();
+
+			if (_requests.worker_blocked()) {
 				/* that should not happen and is most likely a bug in the client */
-				error(__func__, ": ", this, ": request pending: ", _pending_request,
-				      " cannot schedule new request: ", request);
+				error(__func__, ": ", this, ": request pending, "
+				      "cannot schedule new request: ", request);
 				fail_fn();
 				return;
 			}
@@ -1061,29 +2639,90 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 				return;
 			}
 
-			_pending_request = request;
-			_lx_task_args._pending_request   = &_pending_request;
-			_lx_task_args._completed_request = &_completed_request;
+			if (!_requests.enqueue(request, true)) {
+				error(__func__, ": ", this, ": request queue full, "
+				      "cannot schedule new request: ", request);
+				fail_fn();
+				return;
+			}
 
 			/*
-			 * Whenever the pending request gets scheduled the
-			 * completed request is reset beforehand. So ending
-			 * up with an unsuccessful completed request either
-			 * means the request failed or it has not yet been
-			 * finished. For the time being this differentiation
-			 * is done by the calling RPC function where a failed
-			 * request is treat appropriately.
+			 * Executing the worker drains all queued requests, which
+			 * includes any deferred ones in front of this request.
 			 */
+			_execute_worker();
 
-			lx_emul_task_unblock(_lx_task);
-			Lx_kit::env().scheduler.execute();
+			Gpu::Request completed { };
+			if (_requests.with_completed(request.tag, [&] (Gpu::Request const &r) {
+				completed = r; })) {
 
-			if (_completed_request.success) {
-				succ_fn(_completed_request);
+				if (completed.success)
+					succ_fn(completed);
+				else
+					fail_fn();
+				return;
 			}
-			else {
-				fail_fn();
+
+			/*
+			 * The request is still in flight. Blocking requests are
+			 * collected later on by the calling RPC function, for all
+			 * others the result is of no interest anymore.
+			 */
+			if (!_blocking(request))
+				_requests.orphan(request.tag);
+
+			fail_fn();
+		}
+
+		/*
+		 * Requests whose result is not needed by the client are only
+		 * enqueued and processed in one batch together with the next
+		 * scheduled request or when the deferred handler kicks in.
+		 */
+		void _handle_deferred()
+		{
+			if (!_requests.empty() && !_requests.worker_blocked())
+				_execute_worker();
+		}
+
+		Genode::Signal_handler<Session_component> _deferred_sigh {
+			_ep, *this, &Session_component::_handle_deferred };
+
+		void _defer_request(Gpu::Request const &request)
+		{
+			if (!_managed_id(request))
+				return;
+
+			if (_depends_on_execs(request))
+				_release_held_execs();
+
+			/*
+			 * A worker blocked in WAIT cannot drain the queue. Instead of
+			 * dropping the request, which would leak its handle, hold back
+			 * the client until the worker made progress.
+			 */
+			while (_requests.full()) {
+				if (_requests.worker_blocked())
+					_ep.wait_and_dispatch_one_io_signal();
+				else
+					_handle_deferred();
+			}
+
+			if (!_requests.enqueue(request, false)) {
+				error(__func__, ": ", this, ": request queue full, "
+				      "dropping request: ", request);
+				return;
 			}
+
+			_deferred_sigh.local_submit();
+		}
+
+		void _trim_bo_cache(Genode::size_t limit)
+		{
+			Gpu::Request r = Gpu::Request::create(this, Gpu::Operation::Type::TRIM);
+			r.operation.size = (uint32_t)limit;
+
+			_defer_request(r);
 		}
 
 		bool _local_request(Gpu::Local_request::Type type)
@@ -1095,8 +2734,7 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 			_lx_task_args._local_request = &local_request;
 
 			// XXX must not return prematurely
-			lx_emul_task_unblock(_lx_task);
-			Lx_kit::env().scheduler.execute();
+			_execute_worker();
 
 			bool const success = _lx_task_args._local_request->success;
 			_lx_task_args._local_request = nullptr;
@@ -1121,16 +2759,6 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 			return ctx_id;
 		}
 
-		void _free_ctx(Gpu::Ctx_id ctx_id)
-		{
-			Gpu::Request r = Gpu::Request::create(this, Gpu::Operation::Type::CTX_FREE);
-			r.operation.ctx_id = ctx_id;
-
-			auto success = [&] (Gpu::Request const &) { };
-			auto fail = [&] () { warning("could not free ctx_id: ", ctx_id.value); };
-			_schedule_request(r, success, fail);
-		}
-
 		Gpu::Syncobj_id _sync_id[Gpu::Operation::MAX_PIPE] { { 0 }, { 0 } };
 
 		Gpu::Syncobj_id _create_syncobj()
@@ -1148,34 +2776,54 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 			return syncobj_id;
 		}
 
-		void _destroy_syncobj(Gpu::Syncobj_id syncobj_id)
-		{
-			Gpu::Request r = Gpu::Request::create(this, Gpu::Operation::Type::SYNCOBJ_DESTROY);
-			r.operation.syncobj_id[0] = syncobj_id;
+		/*
+		 * Waiting for access to a given buffer-object is done
+		 * by calling the corresponding DRM function with a huge
+		 * timeout. In case we have to wait the task will be
+		 * blocked and the schedule execution returns. We treat
+		 * this as a pending operation and the client will wait
+		 * until it is notified via a signal and tries to
+		 * perform the waiting again. The tag of the pending
+		 * request is used to collect its completion.
+		 *
+		 * Sync objects are merely polled, see 'complete'.
+		 */
 
-			auto success = [&] (Gpu::Request const &) { };
-			auto fail = [&] () { warning("could not destroy syncobj: ", syncobj_id.value); };
-			_schedule_request(r, success, fail);
-		}
+		Gpu::Request::Tag _pending_wait { 0 };
 
 		/*
-		 * Waiting for an sync object and waiting for access
-		 * to a given buffer-object is done by calling the
-		 * corresponding DRM functions with a huge timeout.
-		 * In case we have to wait the task will be blocked
-		 * and the schedule execution returns. We treat this
-		 * as a pending operation and the client will wait
-		 * until it is notified via a signal and tries to
-		 * perform the waiting again.
+		 * Look up the result of a previously interrupted wait
+		 *
+		 * Returns true if the call was handled, i.e., the wait
+		 * is still in flight or its result was collected.
 		 */
+		bool _collect_pending(Gpu::Request::Tag &tag, bool &result)
+		{
+			if (!tag.value)
+				return false;
 
-		bool _pending_syncobj_wait { false };
-		bool _pending_wait         { false };
+			if (_requests.in_flight(tag)) {
+				result = false;
+				return true;
+			}
+
+			bool const collected =
+				_requests.with_completed(tag, [&] (Gpu::Request const &r) {
+					result = r.success; });
+
+			tag = Gpu::Request::Tag { 0 };
+			return collected;
+		}
 
 		struct Notifier : Syncobj_notifier
 		{
 			void _handle_notifier()
 			{
+				/* a blocked worker is waited for by the next RPC */
+				if (!_sc._requests.worker_blocked()
+				 && !_fair_share.hold(_sc._share))
+					_sc._release_held_execs();
+
 				_sc.submit_completion_signal();
 			}
 
@@ -1196,13 +2844,17 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 
 		Notifier _notifier { _env.ep(), *this };
 
-		/*
-		 * Free buffer-object
+		/**
+		 * Destroy the book-keeping of a buffer owned by this session
 		 *
 		 * Implemented here as it is used by 'unmap_gpu' as well as the
 		 * Session_component destructor to clean up.
+		 *
+		 * \param export_name  global name of the buffer if it was exported
+		 *
+		 * \return false if the session does not own the buffer
 		 */
-		bool _unmap_gpu(Vram_id id, Genode::off_t, Virtual_address)
+		bool _dissolve_vram(Vram_id id, Vram_local::Export_name &export_name)
 		{
 			Gpu::Vram_capability const cap = _vram_local_space.lookup_vram_cap(id);
 			if (!cap.valid()) {
@@ -1233,23 +2885,35 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 				vlp = &vl;
 			});
 
-			Gpu::Request r = Gpu::Request::create(this, Gpu::Operation::Type::FREE);
-			r.operation.id = id;
-
 			if (vlp) {
-				Vram_local::Export_name const export_name = vlp->export_name;
-				if (export_name.valid()) {
-					r.operation.handle = export_name.value;
-				}
-
+				export_name = vlp->export_name;
 				Genode::destroy(_heap, vlp);
 			}
 
 			Genode::destroy(_heap, vp);
 
-			auto success = [&] (Gpu::Request const &) { };
-			auto fail = [&] () { };
-			_schedule_request(r, success, fail);
+			return true;
+		}
+
+		/*
+		 * Free buffer-object
+		 */
+		bool _unmap_gpu(Vram_id id, Genode::off_t, Virtual_address)
+		{
+			/* held submits may reference the buffer */
+			_release_held_execs();
+
+			Vram_local::Export_name export_name { 0, false };
+			if (!_dissolve_vram(id, export_name))
+				return false;
+
+			Gpu::Request r = Gpu::Request::create(this, Gpu::Operation::Type::FREE);
+			r.operation.id = id;
+
+			if (export_name.valid())
+				r.operation.handle = export_name.value;
+
+			_defer_request(r);
 
 			return true;
 		}
@@ -1265,14 +2929,20 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 		                  Genode::Entrypoint &ep,
 		                  Resources    const &resources,
 		                  Label        const &label,
+		                  Gpu::Config  const &config,
+		                  unsigned            weight,
 		                  Genode::Id_space<Session_component> &space)
 		:
 			Session_object { ep, resources, label },
 			_env           { env },
 			_ep            { ep },
+			_config        { config },
+			_donated_ram   { resources.ram_quota.value },
 			_elem          { *this, space },
-			_lx_task_args  { _env.rm(), _worker_buffers, _vram_local_space, _notifier },
-			_lx_task       { create_gpu_task(&_lx_task_args ) }
+			_lx_task_args  { _env.rm(), _heap, _worker_buffers, _vram_local_space,
+			                 _notifier },
+			_lx_task       { create_gpu_task(&_lx_task_args ) },
+			_share         { _fair_share, weight, _lx_task_args.stats, _notifier }
 		{
 			if (!_lx_task) {
 				Genode::error("could not create GPU task");
@@ -1280,16 +2950,37 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 			}
 
 			_lx_task_args._gpu_task = _lx_task;
+			_lx_task_args._requests = &_requests;
 
-			if (!_local_request(Gpu::Local_request::Type::OPEN)) {
-				Genode::warning("could not open DRM session");
-				throw Could_not_open_drm();
-			}
+			_update_cache_limit();
+
+			if (_job_trace.constructed())
+				_lx_task_args.trace_label = _job_trace->label_id(label);
+
+			Gpu::Drm_pool::File file { };
+
+			if (_drm_pool.constructed() && _drm_pool->claim(file)) {
+
+				/* the worker adopts the prepared DRM file */
+				_lx_task_args.drm  = file.drm;
+				_lx_task_args.info = file.info;
+
+				_ctx_id     = file.ctx_id;
+				_sync_id[0] = file.sync_id[0];
+				_sync_id[1] = file.sync_id[1];
 
-			_ctx_id = _create_ctx();
+			} else {
 
-			_sync_id[0] = _create_syncobj();
-			_sync_id[1] = _create_syncobj();
+				if (!_local_request(Gpu::Local_request::Type::OPEN)) {
+					Genode::warning("could not open DRM session");
+					throw Could_not_open_drm();
+				}
+
+				_ctx_id = _create_ctx();
+
+				_sync_id[0] = _create_syncobj();
+				_sync_id[1] = _create_syncobj();
+			}
 
 			void *info = _info_dataspace.local_addr<void>();
 			Genode::memcpy(info, &_lx_task_args.info, sizeof (Gpu::Info_lima));
@@ -1297,57 +2988,77 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 
 		virtual ~Session_component()
 		{
-			/*
-			 * Close all imported handles (those were not created by this
-			 * sessions so the the export handle must be invalid).
-			 */
-			_vram_local_space.for_each<Vram_local>([&] (Vram_local &vl) {
-
-				if (vl.export_name.valid())
-					return;
-
-				if (!vl.import_handle.valid())
-					return;
-
-				Gpu::Request r = Gpu::Request::create(this, Gpu::Operation::Type::CLOSE);
-				r.operation.id = Gpu::Vram_id { .value = vl._elem.id().value };
-				r.operation.handle = vl.import_handle.value;
+			/* process all held and deferred requests before tearing down */
+			_release_held_execs();
+			_handle_deferred();
 
-				auto success = [&] (Gpu::Request const &) { };
-				auto fail = [&] () { };
-				_schedule_request(r, success, fail);
-			});
+			if (_requests.worker_blocked())
+				Genode::warning("destructor override currently pending request");
 
 			/*
-			 * Close all exported handles and free buffer objects owned by this session.
-			 *
-			 * Additionally destroy all imported handles we closed before.
+			 * Only the book-keeping of the buffers is destroyed here. The
+			 * worker releases all GEM handles, imported or owned, together
+			 * with the context and the sync objects when closing the DRM
+			 * file below instead of processing one request per object.
 			 */
-			while (_vram_local_space.apply_any<Vram_local>([&] (Vram_local &vl) {
-
-				if (vl.import_handle.valid()) {
-					Genode::destroy(_heap, &vl);
-					return;
-				}
+			while (_vram_local_space.apply_any([&] (Vram_local &vl) {
 
-				if (!_unmap_gpu(Gpu::Vram_id { .value = vl._elem.id().value }, 0, Gpu::Virtual_address { 0 }))
+				Vram_local::Export_name export_name { 0, false };
+				if (vl.import_handle.valid()
+				 || !_dissolve_vram(Gpu::Vram_id { .value = vl._elem.id().value },
+				                    export_name))
 					Genode::destroy(_heap, &vl);
 			})) { ; }
 
-			if (_lx_task_args._pending_request->valid()) {
-				Genode::warning("destructor override currently pending request");
+			if (_config.verbose) {
+				Gpu::Session_stats const &stats = _lx_task_args.stats;
+				Genode::log("session '", label(), "' flushed ", stats.flushed_bytes,
+				            " bytes in ", stats.submits, " submits");
 			}
 
-			for (unsigned i = 0; i < Gpu::Operation::MAX_PIPE; i++) {
-				_destroy_syncobj(_sync_id[i]);
-			}
+			_fence_tracker.dissolve(_lx_task_args.stats, _notifier);
 
-			_free_ctx(_ctx_id);
+			if (_job_trace.constructed())
+				_job_trace->release(_lx_task_args.trace_label);
 
 			if (!_local_request(Gpu::Local_request::Type::CLOSE))
 				Genode::warning("could not close DRM session - leaking objects");
 		}
 
+		/* state of the previous report used to derive the submit rate */
+		Genode::uint64_t _reported_submits { 0 };
+		Genode::uint64_t _reported_us      { 0 };
+
+		void ram_donated(Genode::Ram_quota quota)
+		{
+			_donated_ram += quota.value;
+			_update_cache_limit();
+		}
+
+		void generate_report(Genode::Generator &g, Genode::uint64_t now_us)
+		{
+			Gpu::Session_stats const &stats = _lx_task_args.stats;
+
+			Genode::uint64_t const us      = now_us - _reported_us;
+			Genode::uint64_t const submits = stats.submits - _reported_submits;
+
+			_reported_us      = now_us;
+			_reported_submits = stats.submits;
+
+			Genode::uint64_t live_bytes = 0;
+			_worker_buffers.for_each([&] (Buffer_object const &bo) {
+				live_bytes += bo.size; });
+
+			g.attribute("label", label());
+			g.attribute("weight", _share.weight);
+			g.attribute("submits_per_sec", us ? (submits*1000*1000)/us : 0);
+			g.attribute("outstanding", _requests.queued());
+			g.attribute("live_bytes", live_bytes);
+			g.attribute("cached_bytes", _worker_buffers.cached_bytes());
+
+			stats.generate(g);
+		}
+
 		void submit_completion_signal()
 		{
 			if (_completion_sigh.valid())
@@ -1372,61 +3083,94 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 			r.operation.syncobj_id[0] = _sync_id[0];
 			r.operation.syncobj_id[1] = _sync_id[1];
 
-			Gpu::Sequence_number seqno { .value = 0 };
+			_fair_share.activate(_share);
 
-			auto success = [&] (Gpu::Request const &request) {
-				seqno = request.operation.seqno;
-			};
-			auto fail = [&] () {
+			if (!_managed_id(r))
+				throw Invalid_state();
+
+			/* keep the order of submits while some are held back */
+			if (_num_held_execs || _fair_share.hold(_share)) {
+
+				Gpu::Sequence_number seqno { .value = 0 };
+				if (_hold_exec(r, seqno))
+					return seqno;
+
+				_release_held_execs();
+			}
+
+			Gpu::Sequence_number const seqno = _submit_exec(r);
+			if (!seqno.value)
 				throw Invalid_state();
-			};
-			_schedule_request(r, success, fail);
 
 			return seqno;
 		}
 
+		/*
+		 * Besides the sync object of one pipe, as returned by 'execute',
+		 * the sequence number may name the sync objects of both pipes.
+		 * The lower 32 bits contain the first, bits 32 to 62 the second
+		 * sync object. If bit 63 is set, the wait completes as soon as
+		 * any of the sync objects is signaled, otherwise once all are.
+		 */
 		bool complete(Gpu::Sequence_number seqno) override
 		{
+			enum : Genode::uint64_t { ANY_BIT = 1ull << 63 };
+
+			Gpu::Syncobj_id const ids[Gpu::Operation::MAX_PIPE] {
+				{ .value = uint32_t(seqno.value) },
+				{ .value = uint32_t((seqno.value & ~ANY_BIT) >> 32) } };
+
 			/* ignore any seqno we are not aware of */
-			bool valid = false;
-			for (auto v : _sync_id) {
-				if (seqno.value == v.value) {
-					valid = true;
-					break;
-				}
-			}
-			if (!valid)
+			auto known = [&] (Gpu::Syncobj_id id) {
+				for (auto v : _sync_id)
+					if (id.value == v.value)
+						return true;
+				return false;
+			};
+			if (!known(ids[0]) || (ids[1].value && !known(ids[1])))
 				return false;
 
-			/* handle previous interrupted call */
-			if (_pending_syncobj_wait) {
-				Gpu::Request *pr = _lx_task_args._pending_request;
-				if (pr && pr->operation.type == Gpu::Operation::Type::SYNCOBJ_WAIT) {
-					return false;
-				}
-
-				Gpu::Request *cr = _lx_task_args._completed_request;
-				if (cr && cr->operation.type == Gpu::Operation::Type::SYNCOBJ_WAIT) {
-					_pending_syncobj_wait = false;
-					return cr->success;
-				}
-			}
+			/* the session may have caught up while the worker was blocked */
+			if (_num_held_execs && !_requests.worker_blocked()
+			 && !_fair_share.hold(_share))
+				_release_held_execs();
 
 			Gpu::Request r = Gpu::Request::create(this, Gpu::Operation::Type::SYNCOBJ_WAIT);
-			r.operation.syncobj_id[0] =
-				Gpu::Syncobj_id { .value = (uint32_t)seqno.value };
+			r.operation.syncobj_id[0] = ids[0];
+			r.operation.syncobj_id[1] = ids[1];
+			r.operation.op = (seqno.value & ANY_BIT) ? Gpu::Operation::WAIT_ANY
+			                                         : Gpu::Operation::WAIT_ALL;
 
 			bool completed = false;
-			_pending_syncobj_wait = false;
 
 			auto success = [&] (Gpu::Request const &request) {
 				completed = request.success;
 			};
-			auto fail = [&] () {
-				_pending_syncobj_wait = true;
-			};
+			auto fail = [&] () { };
 			_schedule_request(r, success, fail);
 
+			/*
+			 * The sync objects still carry the fences of earlier jobs while
+			 * submits are held back. The client gets notified via the
+			 * completion signal once they are released.
+			 */
+			if (_num_held_execs)
+				completed = false;
+
+			/* time the client waits from the first unsuccessful check on */
+			if (_job_trace.constructed()) {
+				if (!completed && !_wait_begin_us)
+					_wait_begin_us = _now_us();
+
+				if (completed && _wait_begin_us) {
+					_job_trace->session_event("WAIT", _lx_task_args.trace_label,
+					                          Gpu::Job_trace::CLIENT,
+					                          Gpu::Job_trace::NO_PIPE,
+					                          _wait_begin_us, _now_us());
+					_wait_begin_us = 0;
+				}
+			}
+
 			return completed;
 		}
 
@@ -1448,13 +3192,22 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 		}
 
 		Genode::Dataspace_capability map_cpu(Gpu::Vram_id id,
-		                                        Gpu::Mapping_attributes) override
+		                                        Gpu::Mapping_attributes attrs) override
 		{
+			_worker_buffers.with_bo(id, [&] (Buffer_object &bo) {
+				bo.cpu_mapped(attrs.writeable, _config.dirty_hints); });
+
 			return _worker_buffers.lookup_buffer(id);
 		}
 
 		void unmap_cpu(Vram_id id) override
 		{
+			/* held submits may reference the buffer */
+			_release_held_execs();
+
+			_worker_buffers.with_bo(id, [&] (Buffer_object &bo) {
+				bo.cpu_unmapped(); });
+
 			Vram_local *vlp = nullptr;
 			_vram_local_space.with_vram_local(id, [&] (Vram_local &vl) {
 
@@ -1472,9 +3225,7 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 				r.operation.id = Gpu::Vram_id { .value = vl._elem.id().value };
 				r.operation.handle = vl.import_handle.value;
 
-				auto success = [&] (Gpu::Request const &) { };
-				auto fail = [&] () { };
-				_schedule_request(r, success, fail);
+				_defer_request(r);
 			});
 
 			if (vlp)
@@ -1484,27 +3235,26 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 		bool map_gpu(Vram_id id, Genode::size_t size, Genode::off_t,
 		             Virtual_address va) override
 		{
-			Genode::Dataspace_capability cap { };
-
-			cap = _worker_buffers.lookup_buffer(id);
-			if (cap.valid()) {
-				error("Duplicate 'map_gpu' called for ", id.value);
-				return false;
-			}
-
 			if (size > ~0U) {
 				error("Allocation of buffers > 4G not supported!");
 				return false;
 			}
 
+			/* give back cached buffer objects when running low on RAM */
+			if (_worker_buffers.cached_bytes()
+			 && _env.pd().avail_ram().value < _config.bo_cache_min_ram)
+				_trim_bo_cache(0);
+
 			Gpu::Request r = Gpu::Request::create(this, Gpu::Operation::Type::ALLOC);
 			r.operation.id   = id;
 			r.operation.va   = (uint32_t) va.value;
 			r.operation.size = (uint32_t) size;
 
 			bool ret = false;
-			auto success = [&] (Gpu::Request const &) {
+			Genode::uint32_t placed_va = 0;
+			auto success = [&] (Gpu::Request const &req) {
 				ret = true;
+				placed_va = req.operation.va;
 			};
 			auto fail = [&] () { };
 			_schedule_request(r, success, fail);
@@ -1515,7 +3265,7 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 				 * rollback the BO allocation.
 				 */
 				ret = false;
-				_worker_buffers.with_bo(id, [&] (Buffer_object const &bo) {
+				_worker_buffers.with_bo(id, [&] (Buffer_object &bo) {
 					Gpu_vram *vram = nullptr;
 
 					try {
@@ -1537,6 +3287,8 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 
 					ret = true;
 				});
+				if (ret && !va.value)
+					_va_info() = Gpu::Va_info { .va = placed_va };
 				if (!ret) {
 					Gpu::Request r = Gpu::Request::create(this, Gpu::Operation::Type::FREE);
 					r.operation.id   = id;
@@ -1560,31 +3312,30 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 		bool set_tiling_gpu(Gpu::Vram_id id, Genode::off_t,  unsigned mode) override
 		{
 			/* handle previous interrupted call */
-			if (_pending_wait) {
-				Gpu::Request *pr = _lx_task_args._pending_request;
-				if (pr && pr->operation.type == Gpu::Operation::Type::WAIT) {
-					return false;
-				}
+			bool pending_result = false;
+			if (_collect_pending(_pending_wait, pending_result))
+				return pending_result;
 
-				Gpu::Request *cr = _lx_task_args._completed_request;
-				if (cr && cr->operation.type == Gpu::Operation::Type::WAIT) {
-					_pending_wait = false;
-					return cr->success;
-				}
-			}
+			/*
+			 * The client waits for writing when it is about to modify
+			 * the buffer via its CPU mapping.
+			 */
+			enum { LIMA_GEM_WAIT_WRITE = 0x02 };
+			if (mode & LIMA_GEM_WAIT_WRITE)
+				_worker_buffers.with_bo(id, [&] (Buffer_object &bo) {
+					bo.mark_dirty(); });
 
 			Gpu::Request r = Gpu::Request::create(this, Gpu::Operation::Type::WAIT);
 			r.operation.id = id;
 			r.operation.op = mode;
 
 			bool completed = false;
-			_pending_wait = false;
 
 			auto success = [&] (Gpu::Request const &request) {
 				completed = request.success;
 			};
 			auto fail = [&] () {
-				_pending_wait = true;
+				_pending_wait = r.tag;
 			};
 			_schedule_request(r, success, fail);
 
@@ -1669,6 +3420,7 @@ struct Gpu::Session_component : public Genode::Session_object<Gpu::Session>
 						vl.import_handle =
 							Vram_local::Import_handle { request.operation.handle,
 							                            true };
+						_vram_generation++;
 					};
 					auto fail = [&] () { };
 					_schedule_request(r, success, fail);
@@ -1694,17 +3446,35 @@ struct Gpu::Root : Gpu::Root_component
 		Genode::Env       &_env;
 		Genode::Allocator &_alloc;
 
+		Gpu::Config const _config;
+
 		Gpu::Session_space _session_space { };
 
+		/* config ROM of the driver, the weight policies are looked up there */
+		Genode::Attached_rom_dataspace const &_config_rom;
+
+		unsigned _weight(Genode::Session_label const &label)
+		{
+			unsigned weight = Gpu::Fair_share::DEFAULT_WEIGHT;
+			with_matching_policy(label, _config_rom.node(),
+				[&] (Genode::Node const &policy) {
+					weight = policy.attribute_value("weight", weight); },
+				[&] { });
+
+			return weight;
+		}
+
 
 	protected:
 
 		Create_result _create_session(char const *args) override
 		{
+			Genode::Session_label const label = session_label_from_args(args);
+
 			return *new (_alloc)
 				Session_component(_env, _env.ep(),
 				                  session_resources_from_args(args),
-				                  session_label_from_args(args),
+				                  label, _config, _weight(label),
 				                  _session_space);
 		}
 
@@ -1712,6 +3482,7 @@ struct Gpu::Root : Gpu::Root_component
 		{
 			sc.upgrade(ram_quota_from_args(args));
 			sc.upgrade(cap_quota_from_args(args));
+			sc.ram_donated(ram_quota_from_args(args));
 		}
 
 		void _destroy_session(Session_component &sc) override
@@ -1721,22 +3492,49 @@ struct Gpu::Root : Gpu::Root_component
 
 	public:
 
-		Root(Genode::Env &env, Genode::Allocator &alloc)
+		void generate_report(Genode::Generator &g)
+		{
+			Genode::uint64_t const now_us = _now_us();
+
+			if (_runtime_pm.constructed())
+				g.node("power", [&] { _runtime_pm->generate(g); });
+
+			if (_drm_pool.constructed())
+				g.node("drm_pool", [&] { _drm_pool->generate(g); });
+
+			_session_space.for_each<Session_component>([&] (Session_component &sc) {
+				g.node("session", [&] { sc.generate_report(g, now_us); }); });
+		}
+
+		Root(Genode::Env &env, Genode::Allocator &alloc,
+		     Genode::Attached_rom_dataspace const &config_rom)
 		:
 			Root_component { env.ep(), alloc },
 			_env           { env },
-			_alloc         { alloc }
-		{ }
+			_alloc         { alloc },
+			_config        { Gpu::Config::from_node(config_rom.node()) },
+			_config_rom    { config_rom }
+		{
+			_fair_share.slice_us = _config.fair_slice_us;
+
+			if (_config.idle_timeout_us)
+				_runtime_pm.construct(_config.idle_timeout_us);
+
+			if (_config.drm_pool) {
+				_drm_pool.construct(env.ep(), _config.drm_pool);
+				_drm_pool->refill();
+			}
+		}
 };
 
 
 static Genode::Constructible<Gpu::Root> _gpu_root { };
 
 
-void lx_emul_announce_gpu_session(void)
+void lx_emul_announce_gpu_session(Genode::Attached_rom_dataspace const &config_rom)
 {
 	if (!_gpu_root.constructed()) {
-		_gpu_root.construct(Lx_kit::env().env, Lx_kit::env().heap);
+		_gpu_root.construct(Lx_kit::env().env, Lx_kit::env().heap, config_rom);
 
 		Genode::Entrypoint &ep = Lx_kit::env().env.ep();
 		Lx_kit::env().env.parent().announce(ep.manage(*_gpu_root));
@@ -1770,6 +3568,59 @@ struct Driver::Main
 		Lx_kit::env().scheduler.execute();
 	}
 
+	/*
+	 * Periodic report of per-session statistics, disabled by default
+	 */
+	uint64_t const _report_period_ms {
+		_config_rom.node().attribute_value("report_period_ms", 0UL) };
+
+	Constructible<Timer::Periodic_timeout<Main>> _report_timeout { };
+	Constructible<Expanding_reporter>            _stats_reporter { };
+
+	void _handle_report(Duration)
+	{
+		if (!_gpu_root.constructed())
+			return;
+
+		_stats_reporter->generate([&] (Generator &g) {
+			_gpu_root->generate_report(g); });
+	}
+
+	/*
+	 * Periodic dump of the job trace as Chrome trace JSON, disabled by
+	 * default
+	 */
+	unsigned const _trace_events {
+		_config_rom.node().attribute_value("trace_events", 0U) };
+
+	uint64_t const _trace_period_ms {
+		_config_rom.node().attribute_value("trace_period_ms", 1000UL) };
+
+	/* generous estimate of the JSON size per event */
+	enum { TRACE_BYTES_PER_EVENT = 256 };
+
+	struct Trace_report
+	{
+		Report::Connection _connection;
+		Attached_dataspace _ds;
+
+		Trace_report(Env &env, size_t size)
+		:
+			_connection { env, "gpu_trace", size },
+			_ds         { env.rm(), _connection.dataspace() }
+		{ }
+
+		void submit()
+		{
+			_connection.submit(_job_trace->generate_json(_ds.bytes()));
+		}
+	};
+
+	Constructible<Trace_report>                  _trace_report  { };
+	Constructible<Timer::Periodic_timeout<Main>> _trace_timeout { };
+
+	void _handle_trace(Duration) { _trace_report->submit(); }
+
 	Main(Env &env) : _env { env }
 	{
 		log("--- Lima GPU driver started ---");
@@ -1777,14 +3628,32 @@ struct Driver::Main
 		Lx_kit::initialize(_env, _signal_handler);
 		_env.exec_static_constructors();
 
-		_lx_user_task_args.create_task  = false;
-		_lx_user_task_args.args         = nullptr;
-		_lx_user_task_args.new_gpu_task = nullptr;
+		_lx_user_task_args.create_task    = false;
+		_lx_user_task_args.args           = nullptr;
+		_lx_user_task_args.new_gpu_task   = nullptr;
+		_lx_user_task_args.suspend_gpu    = false;
+		_lx_user_task_args.suspend_result = 0;
+		_lx_user_task_args.fill_pool      = false;
 		lx_user_task_args = &_lx_user_task_args;
 
+		if (_trace_events) {
+			_job_trace.construct(Lx_kit::env().heap, _trace_events);
+			_trace_report.construct(_env, 4096 + _trace_events*TRACE_BYTES_PER_EVENT);
+			_trace_timeout.construct(Lx_kit::env().timer, *this,
+			                         &Main::_handle_trace,
+			                         Microseconds { 1000*_trace_period_ms });
+		}
+
 		lx_emul_start_kernel(_dtb_rom.local_addr<void>());
 
-		lx_emul_announce_gpu_session();
+		lx_emul_announce_gpu_session(_config_rom);
+
+		if (_report_period_ms) {
+			_stats_reporter.construct(_env, "gpu_stats", "gpu_stats");
+			_report_timeout.construct(Lx_kit::env().timer, *this,
+			                          &Main::_handle_report,
+			                          Microseconds { 1000*_report_period_ms });
+		}
 	}
 };
 
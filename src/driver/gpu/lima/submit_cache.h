@@ -0,0 +1,188 @@
+/*
+ * \brief  Cache of resolved submit buffer lists
+ * \date   2026-10-17
+ *
+ * Render loops tend to submit the same set of buffer objects frame after
+ * frame. Instead of resolving each client-local buffer id of a submit anew,
+ * the worker keeps the resolved lists of the most recent submits. A list is
+ * keyed by the sequence of buffer ids together with their read flags and
+ * tagged with a generation number. The generation is advanced whenever a
+ * buffer id is added, removed, or its resolution changes, which renders all
+ * cached lists stale.
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is distributed under the terms of the GNU General Public License
+ * version 2.
+ */
+
+#ifndef _SUBMIT_CACHE_H_
+#define _SUBMIT_CACHE_H_
+
+/* Genode includes */
+#include <base/allocator.h>
+#include <base/stdint.h>
+#include <util/noncopyable.h>
+
+namespace Gpu { template <typename> class Submit_cache; }
+
+
+template <typename T>
+class Gpu::Submit_cache : Genode::Noncopyable
+{
+	public:
+
+		struct Key
+		{
+			Genode::uint32_t id;
+			bool             read;
+
+			bool operator == (Key const &other) const {
+				return id == other.id && read == other.read; }
+		};
+
+		struct Entry
+		{
+			Key              key;
+			T               *obj;     /* may be nullptr */
+			Genode::uint32_t handle;
+		};
+
+	private:
+
+		enum { LISTS = 4 };
+
+		struct List
+		{
+			Entry            *entries;
+			unsigned          capacity;
+			unsigned          count;
+			unsigned          generation;
+			Genode::uint64_t  last_use;
+			bool              valid;
+		};
+
+		/*
+		 * Noncopyable
+		 */
+		Submit_cache(Submit_cache const &) = delete;
+		Submit_cache &operator = (Submit_cache const &) = delete;
+
+		Genode::Allocator &_alloc;
+
+		List _lists[LISTS] { };
+
+		Genode::uint64_t _use { 0 };
+
+		List *_prepared { nullptr };
+
+		void _free(List &list)
+		{
+			if (list.entries)
+				_alloc.free(list.entries, sizeof(Entry)*list.capacity);
+
+			list = List { };
+		}
+
+	public:
+
+		Submit_cache(Genode::Allocator &alloc) : _alloc { alloc } { }
+
+		~Submit_cache()
+		{
+			for (List &list : _lists)
+				_free(list);
+		}
+
+		/**
+		 * Look up the resolved list matching a submit
+		 *
+		 * \param key_fn  functor returning the 'Key' of the i-th buffer
+		 *                of the submit
+		 *
+		 * \return entries of the list or nullptr if no valid list of the
+		 *         current 'generation' matches
+		 */
+		template <typename KEY_FN>
+		Entry const *lookup(unsigned generation, unsigned count,
+		                    KEY_FN const &key_fn)
+		{
+			_prepared = nullptr;
+
+			for (List &list : _lists) {
+
+				if (!list.valid || list.count != count)
+					continue;
+
+				if (list.generation != generation) {
+					list.valid = false;
+					continue;
+				}
+
+				unsigned i = 0;
+				while (i < count && list.entries[i].key == key_fn(i))
+					i++;
+
+				if (i < count)
+					continue;
+
+				list.last_use = ++_use;
+				return list.entries;
+			}
+
+			return nullptr;
+		}
+
+		/**
+		 * Provide entries to be filled in by the caller
+		 *
+		 * The least recently used list is evicted. The filled-in entries
+		 * become visible to 'lookup' only after calling 'commit'.
+		 *
+		 * \return nullptr if the entries could not be allocated
+		 */
+		Entry *prepare(unsigned count)
+		{
+			List *lru = &_lists[0];
+			for (List &list : _lists) {
+				if (!list.valid) {
+					lru = &list;
+					break;
+				}
+				if (list.last_use < lru->last_use)
+					lru = &list;
+			}
+
+			List &list = *lru;
+			list.valid = false;
+
+			if (list.capacity < count) {
+				_free(list);
+				try {
+					list.entries  = new (_alloc) Entry[count];
+					list.capacity = count;
+				} catch (...) {
+					return nullptr;
+				}
+			}
+
+			list.count = count;
+			_prepared  = &list;
+			return list.entries;
+		}
+
+		void commit(unsigned generation)
+		{
+			if (!_prepared)
+				return;
+
+			_prepared->generation = generation;
+			_prepared->last_use   = ++_use;
+			_prepared->valid      = true;
+			_prepared = nullptr;
+		}
+};
+
+#endif /* _SUBMIT_CACHE_H_ */
@@ -0,0 +1,168 @@
+/*
+ * \brief  Test and micro-benchmark for the A64 audio sample conversion
+ * \date   2026-10-17
+ *
+ * The test compares the results of the vectorized conversion kernels with
+ * the scalar reference and measures the time needed to convert one period.
+ * The test does not depend on the audio hardware and can be executed on
+ * any platform, e.g., base-linux, where the generic vector version is
+ * compared with the scalar one. On ARM, the NEON version is covered too.
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is distributed under the terms of the GNU General Public License
+ * version 2.
+ */
+
+/* Genode includes */
+#include <base/component.h>
+#include <base/log.h>
+#include <timer_session/connection.h>
+
+/* local includes */
+#include <convert.h>
+
+namespace Test {
+
+	using namespace Genode;
+
+	struct Main;
+}
+
+
+struct Test::Main
+{
+	Env &_env;
+
+	Timer::Connection _timer { _env };
+
+	/* odd number of frames to cover the scalar tail of the kernels */
+	static constexpr unsigned FRAMES      = 512 + 7;
+	static constexpr unsigned NUM_PERIODS = 20000;
+
+	float   _left [FRAMES] { };
+	float   _right[FRAMES] { };
+	int16_t _s16_ref[FRAMES*2] { };
+	int16_t _s16    [FRAMES*2] { };
+	float   _mix_ref[FRAMES] { };
+	float   _mix    [FRAMES] { };
+	float   _acc_ref[FRAMES] { };
+	float   _acc    [FRAMES] { };
+
+	struct Failed : Exception { };
+
+	static void _assert(bool condition, char const *msg)
+	{
+		if (condition)
+			return;
+
+		error("check failed: ", msg);
+		throw Failed();
+	}
+
+	/* deterministic pseudo-random samples exceeding the range of [-1, 1] */
+	void _generate()
+	{
+		uint32_t seed = 0x1234567;
+		auto next = [&] {
+			seed = seed*1103515245 + 12345;
+			return float(int32_t(seed >> 8) - (1 << 23))/float(1 << 23)*1.25f;
+		};
+
+		for (unsigned i = 0; i < FRAMES; i++) {
+			_left[i]  = next();
+			_right[i] = next();
+		}
+
+		/* boundaries */
+		_left[0] =  1.0f; _left[1] = -1.0f;
+		_left[2] =  2.0f; _left[3] = -2.0f;
+		_left[4] =  0.0f; _left[5] = 1.0f/32767;
+	}
+
+	template <typename KERNELS>
+	void _check(char const *name)
+	{
+		using Audio::Convert::Scalar;
+
+		Scalar ::float_to_s16_stereo(_s16_ref, _left, _right, FRAMES);
+		KERNELS::float_to_s16_stereo(_s16,     _left, _right, FRAMES);
+		for (unsigned i = 0; i < FRAMES*2; i++)
+			_assert(_s16[i] == _s16_ref[i], "float to S16 stereo");
+
+		Scalar ::float_to_s16_stereo(_s16_ref, _left, nullptr, FRAMES);
+		KERNELS::float_to_s16_stereo(_s16,     _left, nullptr, FRAMES);
+		for (unsigned i = 0; i < FRAMES*2; i++)
+			_assert(_s16[i] == _s16_ref[i], "float to S16 with silent channel");
+
+		Scalar ::s16_stereo_to_float_mix(_mix_ref, _s16_ref, FRAMES);
+		KERNELS::s16_stereo_to_float_mix(_mix,     _s16_ref, FRAMES);
+		for (unsigned i = 0; i < FRAMES; i++)
+			_assert(_mix[i] == _mix_ref[i], "S16 stereo to float mix");
+
+		/* the multiply-add may be fused, which affects the rounding */
+		for (unsigned i = 0; i < FRAMES; i++)
+			_acc_ref[i] = _acc[i] = _right[i];
+
+		Scalar ::accumulate(_acc_ref, _left, 0.7f, FRAMES);
+		KERNELS::accumulate(_acc,     _left, 0.7f, FRAMES);
+		for (unsigned i = 0; i < FRAMES; i++) {
+			float const diff = _acc[i] - _acc_ref[i];
+			_assert(diff < 1e-6f && diff > -1e-6f, "accumulate with gain");
+		}
+
+		log(name, ": results match scalar reference");
+	}
+
+	void _measure(char const *name, auto const &fn)
+	{
+		uint64_t const start_us = _timer.elapsed_us();
+
+		for (unsigned i = 0; i < NUM_PERIODS; i++)
+			fn();
+
+		uint64_t const duration_us = _timer.elapsed_us() - start_us;
+
+		log("  ", name, ": ", (duration_us*1000)/NUM_PERIODS, " ns per period");
+	}
+
+	template <typename KERNELS>
+	void _benchmark(char const *name)
+	{
+		log(name, ": ", NUM_PERIODS, " periods of ", FRAMES, " frames");
+
+		_measure("float to S16 stereo", [&] {
+			KERNELS::float_to_s16_stereo(_s16, _left, _right, FRAMES); });
+
+		_measure("S16 stereo to float", [&] {
+			KERNELS::s16_stereo_to_float_mix(_mix, _s16_ref, FRAMES); });
+
+		_measure("accumulate", [&] {
+			KERNELS::accumulate(_acc, _left, 0.5f, FRAMES); });
+	}
+
+	Main(Env &env) : _env(env)
+	{
+		using namespace Audio::Convert;
+
+		_generate();
+
+		_check<Vector>("vector");
+#if defined(__ARM_NEON)
+		_check<Neon>("NEON");
+#endif
+
+		_benchmark<Scalar>("scalar");
+		_benchmark<Vector>("vector");
+#if defined(__ARM_NEON)
+		_benchmark<Neon>("NEON");
+#endif
+
+		log("Test done.");
+	}
+};
+
+
+void Component::construct(Genode::Env &env) { static Test::Main main(env); }
@@ -0,0 +1,4 @@
+TARGET  := test-a64_audio_convert
+SRC_CC  := main.cc
+LIBS    += base
+INC_DIR += $(REP_DIR)/src/driver/audio/a64
@@ -0,0 +1,302 @@
+/*
+ * \brief  Test and micro-benchmark for the lima driver's handle table
+ * \date   2026-10-17
+ *
+ * The benchmark mimics the lookups performed by the GPU worker for each
+ * buffer object referenced by a submit and compares the handle table with
+ * the exception-based 'Id_space' lookup previously used. The test does not
+ * depend on the GPU and can be executed on any platform, e.g., base-linux.
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is distributed under the terms of the GNU General Public License
+ * version 2.
+ */
+
+/* Genode includes */
+#include <base/component.h>
+#include <base/heap.h>
+#include <base/id_space.h>
+#include <base/log.h>
+#include <timer_session/connection.h>
+
+/* local includes */
+#include <handle_table.h>
+
+namespace Test {
+
+	using namespace Genode;
+
+	struct Object;
+	struct Entry;
+	struct Main;
+}
+
+
+struct Test::Object
+{
+	using Table = Gpu::Handle_table<Object>;
+
+	uint32_t const value;
+
+	Id_space<Object>::Element const _space_elem;
+	Table::Element            const _table_elem;
+
+	Object(Id_space<Object> &space, Table &table, uint32_t id)
+	:
+		value       { id },
+		_space_elem { *this, space, Id_space<Object>::Id { .value = id } },
+		_table_elem { *this, table, Table::Id { .value = id } }
+	{ }
+};
+
+
+/*
+ * Object managed by the handle table only
+ */
+struct Test::Entry
+{
+	using Table = Gpu::Handle_table<Entry>;
+
+	uint32_t const value;
+
+	Table::Element const _elem;
+
+	Entry(Table &table, uint32_t id)
+	:
+		value { id }, _elem { *this, table, Table::Id { .value = id } }
+	{ }
+};
+
+
+struct Test::Main
+{
+	Env &_env;
+
+	Heap _heap { _env.ram(), _env.rm() };
+
+	Timer::Connection _timer { _env };
+
+	Id_space<Object> _space { };
+	Object::Table    _table { _heap };
+
+	/* hundreds of buffer objects per draw call */
+	static constexpr unsigned NUM_OBJECTS     = 1024;
+	static constexpr unsigned BOS_PER_SUBMIT  = 384;
+	static constexpr unsigned NUM_SUBMITS     = 2000;
+
+	struct Failed : Exception { };
+
+	static void _assert(bool condition, char const *msg)
+	{
+		if (condition)
+			return;
+
+		error("check failed: ", msg);
+		throw Failed();
+	}
+
+	void _test_correctness()
+	{
+		_assert(_table.count() == NUM_OBJECTS, "count after insertion");
+
+		for (uint32_t id = 1; id <= NUM_OBJECTS; id++) {
+			Object const *obj = _table.lookup({ .value = id });
+			_assert(obj && obj->value == id, "lookup of known id");
+		}
+
+		_assert(!_table.lookup({ .value = 0 }),               "lookup of unknown id");
+		_assert(!_table.lookup({ .value = NUM_OBJECTS + 1 }), "lookup of unknown id");
+
+		/* remove every third object and look up all remaining ones */
+		unsigned removed = 0;
+		for (uint32_t id = 1; id <= NUM_OBJECTS; id += 3) {
+			_table.apply({ .value = id }, [&] (Object &obj) {
+				destroy(_heap, &obj); });
+			removed++;
+		}
+
+		_assert(_table.count() == NUM_OBJECTS - removed, "count after removal");
+
+		for (uint32_t id = 1; id <= NUM_OBJECTS; id++) {
+			bool const expected = (id - 1) % 3 != 0;
+			_assert((_table.lookup({ .value = id }) != nullptr) == expected,
+			        "lookup after removal");
+		}
+
+		/* re-insert removed objects */
+		for (uint32_t id = 1; id <= NUM_OBJECTS; id += 3)
+			new (_heap) Object(_space, _table, id);
+
+		_assert(_table.count() == NUM_OBJECTS, "count after re-insertion");
+
+		bool conflict = false;
+		try { Object obj(_space, _table, 1); }
+		catch (Object::Table::Conflicting_id) { conflict = true; }
+		catch (Id_space<Object>::Conflicting_id) { conflict = true; }
+		_assert(conflict, "conflicting id");
+
+		log("correctness checks passed");
+	}
+
+	/*
+	 * Probe chains of colliding ids, tested on a table of its own
+	 *
+	 * With at most 32 entries, the table keeps its initial capacity of 64
+	 * slots. Ids that differ by multiples of 64, or only in bits that
+	 * cancel out when folding the upper half, share their home slot.
+	 */
+	void _test_collisions()
+	{
+		enum { CAPACITY = 64 };
+
+		Entry::Table table { _heap };
+
+		auto lookup = [&] (uint32_t id) {
+			Entry const *e = table.lookup({ .value = id });
+			return e && e->value == id; };
+
+		auto remove = [&] (uint32_t id) {
+			return table.apply({ .value = id }, [&] (Entry &e) {
+				destroy(_heap, &e); }); };
+
+		/* chain at home slot 5, including ids differing in the high bits */
+		uint32_t const chain[] = { 5, 5 + CAPACITY, 5 + 2*CAPACITY,
+		                           5 + 3*CAPACITY, 5 | (0x40u << 16),
+		                           5 | (0x80u << 16), 5 + 4*CAPACITY };
+		for (uint32_t id : chain)
+			new (_heap) Entry(table, id);
+
+		/* id whose home slot is occupied by the chain */
+		new (_heap) Entry(table, 7);
+
+		for (uint32_t id : chain)
+			_assert(lookup(id), "lookup within probe chain");
+		_assert(lookup(7), "lookup behind probe chain");
+		_assert(!table.lookup({ .value = 5 + 5*CAPACITY }),
+		        "lookup of unknown id with occupied home slot");
+
+		/* remove from the middle and the head of the chain */
+		_assert(remove(5 + 2*CAPACITY), "removal within probe chain");
+		_assert(remove(5), "removal at head of probe chain");
+
+		for (uint32_t id : chain) {
+			bool const expected = id != 5 && id != 5 + 2*CAPACITY;
+			_assert(lookup(id) == expected, "lookup after removal within chain");
+		}
+		_assert(lookup(7), "lookup of shifted entry");
+
+		/* chain wrapping around the end of the table */
+		uint32_t const wrapping[] = { 62, 62 + CAPACITY, 62 + 2*CAPACITY,
+		                              62 + 3*CAPACITY, 62 + 4*CAPACITY };
+		for (uint32_t id : wrapping)
+			new (_heap) Entry(table, id);
+
+		/* home slot 0 is occupied by the wrapped chain */
+		new (_heap) Entry(table, CAPACITY);
+
+		for (uint32_t id : wrapping)
+			_assert(lookup(id), "lookup within wrapped probe chain");
+		_assert(lookup(CAPACITY), "lookup behind wrapped probe chain");
+
+		_assert(remove(62 + CAPACITY), "removal within wrapped probe chain");
+
+		for (uint32_t id : wrapping)
+			_assert(lookup(id) == (id != 62 + CAPACITY),
+			        "lookup after removal within wrapped chain");
+		_assert(lookup(CAPACITY), "lookup of entry shifted across the end");
+
+		/* the table itself detects conflicting ids */
+		bool conflict = false;
+		try { Entry entry(table, 5 + CAPACITY); }
+		catch (Entry::Table::Conflicting_id) { conflict = true; }
+		_assert(conflict, "conflicting id within probe chain");
+
+		_assert(table.count() == 11, "count after collisions");
+
+		while (table.apply_any([&] (Entry &e) { destroy(_heap, &e); }));
+
+		_assert(table.count() == 0, "count after removal of all entries");
+
+		log("collision checks passed");
+	}
+
+	/*
+	 * Every 'miss_interval'th lookup refers to an unknown id, 0 disables
+	 * misses.
+	 */
+	static uint32_t _id(unsigned submit, unsigned i, unsigned miss_interval)
+	{
+		if (miss_interval && (i % miss_interval) == 0)
+			return NUM_OBJECTS + 1 + i;
+
+		return 1 + (submit*7 + i) % NUM_OBJECTS;
+	}
+
+	uint64_t _measure(char const *name, unsigned miss_interval, auto const &lookup_fn)
+	{
+		uint64_t sum = 0;
+
+		uint64_t const start_us = _timer.elapsed_us();
+
+		for (unsigned s = 0; s < NUM_SUBMITS; s++)
+			for (unsigned i = 0; i < BOS_PER_SUBMIT; i++)
+				sum += lookup_fn(_id(s, i, miss_interval));
+
+		uint64_t const duration_us = _timer.elapsed_us() - start_us;
+		uint64_t const lookups     = uint64_t(NUM_SUBMITS)*BOS_PER_SUBMIT;
+
+		log(name, ": ", lookups, " lookups in ", duration_us, " us (",
+		    (duration_us*1000)/lookups, " ns per lookup, ",
+		    duration_us/NUM_SUBMITS, " us per submit)");
+
+		return sum;
+	}
+
+	void _benchmark(unsigned miss_interval)
+	{
+		if (miss_interval)
+			log("benchmark with one miss every ", miss_interval, " lookups");
+		else
+			log("benchmark without misses");
+
+		uint64_t const space_sum = _measure("  Id_space    ", miss_interval,
+			[&] (uint32_t id) -> uint64_t {
+				uint64_t value = 0;
+				try {
+					_space.apply<Object>(Id_space<Object>::Id { .value = id },
+						[&] (Object &obj) { value = obj.value; });
+				} catch (Id_space<Object>::Unknown_id) { }
+				return value;
+			});
+
+		uint64_t const table_sum = _measure("  Handle_table", miss_interval,
+			[&] (uint32_t id) -> uint64_t {
+				Object const *obj = _table.lookup({ .value = id });
+				return obj ? obj->value : 0;
+			});
+
+		_assert(space_sum == table_sum, "benchmark results differ");
+	}
+
+	Main(Env &env) : _env(env)
+	{
+		for (uint32_t id = 1; id <= NUM_OBJECTS; id++)
+			new (_heap) Object(_space, _table, id);
+
+		_test_correctness();
+		_test_collisions();
+
+		_benchmark(0);
+		_benchmark(100);
+
+		while (_table.apply_any([&] (Object &obj) { destroy(_heap, &obj); }));
+
+		log("Test done.");
+	}
+};
+
+
+void Component::construct(Genode::Env &env) { static Test::Main main(env); }
@@ -0,0 +1,4 @@
+TARGET  := test-lima_handle_table
+SRC_CC  := main.cc
+LIBS    += base
+INC_DIR += $(REP_DIR)/src/driver/gpu/lima
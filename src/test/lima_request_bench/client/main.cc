@@ -0,0 +1,318 @@
+/*
+ * \brief  Benchmark of the lima driver's request path
+ * \date   2026-10-17
+ *
+ * The benchmark issues synthetic allocation and submit streams to the
+ * lima driver linked against the mock DRM backend. Hence, it measures the
+ * overhead of the request dispatching within the driver, e.g., on
+ * base-linux, without the need for a Mali GPU.
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is distributed under the terms of the GNU General Public License
+ * version 2.
+ */
+
+/* Genode includes */
+#include <base/attached_dataspace.h>
+#include <base/attached_rom_dataspace.h>
+#include <base/component.h>
+#include <base/log.h>
+#include <gpu/lima_session.h>
+#include <gpu_session/connection.h>
+#include <timer_session/connection.h>
+
+/* local includes */
+#include <mock_submit.h>
+
+namespace Test {
+
+	using namespace Genode;
+
+	struct Submit_buffer;
+	struct Main;
+}
+
+
+/*
+ * Submit buffer of one pipe referencing all data buffers
+ */
+struct Test::Submit_buffer
+{
+	Gpu::Connection &_gpu;
+
+	Gpu::Vram_id const id;
+
+	unsigned const pipe;
+
+	bool const _mapped;
+
+	Attached_dataspace _ds;
+
+	Submit_buffer(Env &env, Gpu::Connection &gpu, Gpu::Vram_id id,
+	              Gpu::Virtual_address va, unsigned pipe)
+	:
+		_gpu    { gpu },
+		id      { id },
+		pipe    { pipe },
+		_mapped { _gpu.map_gpu(id, 64*1024, 0, va) },
+		_ds     { env.rm(), _gpu.map_cpu(id, Gpu::Mapping_attributes::rw()) }
+	{ }
+
+	/*
+	 * The driver replaces the buffer ids by its own handles on submit,
+	 * so the submit has to be written anew each time like a real client
+	 * does.
+	 */
+	void write(Gpu::Vram_id first_bo, unsigned num_bos)
+	{
+		Lima_mock::Submit &submit = *_ds.local_addr<Lima_mock::Submit>();
+
+		submit = Lima_mock::Submit {
+			.ctx = 0, .pipe = pipe, .nr_bos = num_bos, .frame_size = 0,
+			.bos = sizeof(Lima_mock::Submit), .frame = 0,
+			.flags = 0, .in_sync = { 0, 0 }, .out_sync = 0 };
+
+		for (unsigned i = 0; i < num_bos; i++)
+			submit.bo(i) = Lima_mock::Submit_bo {
+				.handle = uint32_t(first_bo.value + i),
+				.flags  = (i % 2) ? Lima_mock::Submit_bo::READ
+				                  : Lima_mock::Submit_bo::WRITE };
+	}
+};
+
+
+struct Test::Main
+{
+	Env &_env;
+
+	Attached_rom_dataspace _config { _env, "config" };
+
+	unsigned const _allocs {
+		_config.node().attribute_value("allocs", 2000u) };
+	unsigned const _frames {
+		_config.node().attribute_value("frames", 500u) };
+	unsigned const _bos_per_submit {
+		_config.node().attribute_value("bos_per_submit", 128u) };
+
+	Timer::Connection _timer { _env };
+
+	Gpu::Connection _gpu { _env };
+
+	Attached_dataspace _info { _env.rm(), _gpu.info_dataspace() };
+
+	uint64_t _placed_va() const
+	{
+		return reinterpret_cast<Gpu::Va_info const *>(
+			_info.local_addr<char const>() + Gpu::Va_info::OFFSET)->va;
+	}
+
+	Io_signal_handler<Main> _completion_handler {
+		_env.ep(), *this, &Main::_handle_completion };
+
+	void _handle_completion() { }
+
+	uint64_t _now_us() { return _timer.curr_time().trunc_to_plain_us().value; }
+
+	enum : uint64_t {
+		BO_SIZE         = 64*1024,
+		SUBMIT_VA       = 0x0100'0000,
+		DATA_VA         = 0x1000'0000,
+		ALLOC_VA        = 0x4000'0000,
+		FIRST_SUBMIT_ID = 1,
+		FIRST_DATA_ID   = 16,
+		ALLOC_ID        = 8,
+		FIRST_PLACED_ID = 1024,
+		HELD_SUBMIT_ID  = 3,
+		HELD_JOBS       = 16,
+		BACKGROUND_JOBS = 8,
+	};
+
+	void _bench_alloc(char const *name, bool vary_va)
+	{
+		Gpu::Vram_id const id { .value = ALLOC_ID };
+
+		unsigned failed = 0;
+
+		uint64_t const start_us = _now_us();
+		for (unsigned i = 0; i < _allocs; i++) {
+
+			uint64_t const offset = vary_va ? (i % 1024)*BO_SIZE : 0;
+			Gpu::Virtual_address const va { .value = ALLOC_VA + offset };
+
+			if (!_gpu.map_gpu(id, BO_SIZE, 0, va)) {
+				failed++;
+				continue;
+			}
+			_gpu.unmap_gpu(id, 0, va);
+		}
+		uint64_t const us = _now_us() - start_us;
+
+		log(name, ": ", _allocs, " alloc/free in ", us, " us, ",
+		    (us*1000)/max(_allocs, 1u), " ns per pair, ", failed, " failed");
+	}
+
+	/*
+	 * Keep a window of live buffers of different sizes placed by the
+	 * driver, replacing the oldest one on each iteration
+	 */
+	void _bench_alloc_placed()
+	{
+		enum { WINDOW = 64 };
+
+		struct Live { uint64_t va, size; bool used; } live[WINDOW] { };
+
+		unsigned failed = 0, overlapping = 0;
+
+		uint64_t const start_us = _now_us();
+		for (unsigned i = 0; i < _allocs; i++) {
+
+			unsigned const slot = i % WINDOW;
+			Gpu::Vram_id const id { .value = FIRST_PLACED_ID + slot };
+
+			if (live[slot].used) {
+				_gpu.unmap_gpu(id, 0, Gpu::Virtual_address { .value = live[slot].va });
+				live[slot].used = false;
+			}
+
+			uint64_t const size = BO_SIZE << (i % 5);
+			if (!_gpu.map_gpu(id, size, 0, Gpu::Virtual_address { .value = 0 })) {
+				failed++;
+				continue;
+			}
+
+			uint64_t const va = _placed_va();
+			for (Live const &l : live)
+				if (l.used && l.va < va + size && va < l.va + l.size)
+					overlapping++;
+
+			live[slot] = { .va = va, .size = size, .used = true };
+		}
+
+		for (unsigned slot = 0; slot < WINDOW; slot++)
+			if (live[slot].used)
+				_gpu.unmap_gpu(Gpu::Vram_id { .value = FIRST_PLACED_ID + slot }, 0,
+				               Gpu::Virtual_address { .value = live[slot].va });
+
+		uint64_t const us = _now_us() - start_us;
+
+		log("alloc (placed): ", _allocs, " alloc/free in ", us, " us, ",
+		    (us*1000)/max(_allocs, 1u), " ns per pair, ", failed, " failed, ",
+		    overlapping, " overlapping");
+	}
+
+	void _wait(Gpu::Sequence_number seqno)
+	{
+		while (!_gpu.complete(seqno))
+			_env.ep().wait_and_dispatch_one_io_signal();
+	}
+
+	void _bench_submit()
+	{
+		for (unsigned i = 0; i < _bos_per_submit; i++) {
+			Gpu::Vram_id const id { .value = FIRST_DATA_ID + i };
+			Gpu::Virtual_address const va { .value = DATA_VA + i*BO_SIZE };
+			if (!_gpu.map_gpu(id, BO_SIZE, 0, va)) {
+				error("could not allocate data buffer ", i);
+				return;
+			}
+		}
+
+		Gpu::Vram_id const first_bo { .value = FIRST_DATA_ID };
+
+		Submit_buffer gp { _env, _gpu, Gpu::Vram_id { .value = FIRST_SUBMIT_ID },
+		                   Gpu::Virtual_address { .value = SUBMIT_VA },
+		                   Lima_mock::PIPE_GP };
+		Submit_buffer pp { _env, _gpu, Gpu::Vram_id { .value = FIRST_SUBMIT_ID + 1 },
+		                   Gpu::Virtual_address { .value = SUBMIT_VA + BO_SIZE },
+		                   Lima_mock::PIPE_PP };
+
+		uint64_t execute_us = 0;
+
+		uint64_t const start_us = _now_us();
+		for (unsigned f = 0; f < _frames; f++) {
+
+			gp.write(first_bo, _bos_per_submit);
+			pp.write(first_bo, _bos_per_submit);
+
+			uint64_t const execute_start_us = _now_us();
+			Gpu::Sequence_number const gp_seqno = _gpu.execute(gp.id, 0);
+			Gpu::Sequence_number const pp_seqno = _gpu.execute(pp.id, 0);
+			execute_us += _now_us() - execute_start_us;
+
+			/* wait for both pipes at once */
+			_wait(Gpu::Sequence_number { .value = gp_seqno.value
+			                                    | (pp_seqno.value << 32) });
+		}
+		uint64_t const us = _now_us() - start_us;
+
+		log("submit: ", _frames, " frames of ", _bos_per_submit, " buffers in ",
+		    us, " us, ", (_frames*1000*1000)/max(us, uint64_t(1)), " frames/s, ",
+		    execute_us/max(2*_frames, 1u), " us per execute");
+	}
+
+	/*
+	 * Keep the PP pipe busy by the jobs of a second session while waiting
+	 * for each GP job of the benchmark session. With a fair slice shorter
+	 * than a PP job, the benchmark session runs ahead and its submits are
+	 * held back by the driver. The sequence numbers returned for held
+	 * submits must complete nevertheless.
+	 */
+	void _bench_held_submit()
+	{
+		Gpu::Connection other { _env };
+
+		Submit_buffer background { _env, other, Gpu::Vram_id { .value = FIRST_SUBMIT_ID },
+		                           Gpu::Virtual_address { .value = SUBMIT_VA },
+		                           Lima_mock::PIPE_PP };
+		Submit_buffer gp { _env, _gpu, Gpu::Vram_id { .value = HELD_SUBMIT_ID },
+		                   Gpu::Virtual_address { .value = SUBMIT_VA + 2*BO_SIZE },
+		                   Lima_mock::PIPE_GP };
+
+		Gpu::Vram_id const no_bo { .value = 0 };
+
+		Gpu::Sequence_number background_seqno { .value = 0 };
+		for (unsigned i = 0; i < BACKGROUND_JOBS; i++) {
+			background.write(no_bo, 0);
+			background_seqno = other.execute(background.id, 0);
+		}
+
+		uint64_t max_us = 0;
+
+		uint64_t const start_us = _now_us();
+		for (unsigned i = 0; i < HELD_JOBS; i++) {
+
+			gp.write(no_bo, 0);
+
+			uint64_t const submit_us = _now_us();
+			_wait(_gpu.execute(gp.id, 0));
+			max_us = max(max_us, _now_us() - submit_us);
+		}
+		uint64_t const us = _now_us() - start_us;
+
+		/* the other session has no completion handler installed */
+		while (!other.complete(background_seqno))
+			_timer.msleep(1);
+
+		log("held submit: ", unsigned(HELD_JOBS), " jobs completed in ", us,
+		    " us, at most ", max_us, " us per job");
+	}
+
+	Main(Env &env) : _env { env }
+	{
+		_gpu.completion_sigh(_completion_handler);
+
+		_bench_alloc("alloc (reused)", false);
+		_bench_alloc("alloc (fresh)",  true);
+		_bench_alloc_placed();
+		_bench_submit();
+		_bench_held_submit();
+
+		log("Test done.");
+	}
+};
+
+
+void Component::construct(Genode::Env &env) { static Test::Main main(env); }
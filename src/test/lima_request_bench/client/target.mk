@@ -0,0 +1,4 @@
+TARGET   = test-lima_request_bench
+SRC_CC   = main.cc
+LIBS     = base
+INC_DIR += $(PRG_DIR)/..
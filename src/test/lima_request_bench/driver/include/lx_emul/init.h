@@ -0,0 +1,26 @@
+/*
+ * \brief  Kernel start-up of the host-side lima driver
+ * \date   2026-10-17
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is distributed under the terms of the GNU General Public License
+ * version 2.
+ */
+
+#ifndef _LX_EMUL__INIT_H_
+#define _LX_EMUL__INIT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void lx_emul_start_kernel(void *dtb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LX_EMUL__INIT_H_ */
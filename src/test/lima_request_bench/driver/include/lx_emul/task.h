@@ -0,0 +1,29 @@
+/*
+ * \brief  Cooperative tasks of the host-side lima driver
+ * \date   2026-10-17
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is distributed under the terms of the GNU General Public License
+ * version 2.
+ */
+
+#ifndef _LX_EMUL__TASK_H_
+#define _LX_EMUL__TASK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct task_struct;
+
+void lx_emul_task_unblock(struct task_struct *task);
+void lx_emul_task_schedule(int block);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LX_EMUL__TASK_H_ */
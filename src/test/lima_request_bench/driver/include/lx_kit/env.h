@@ -0,0 +1,53 @@
+/*
+ * \brief  Environment of the host-side lima driver
+ * \date   2026-10-17
+ *
+ * Provides the subset of the Lx_kit environment used by the lima driver.
+ * The Linux tasks are modelled by threads that are executed strictly one
+ * after another to retain the cooperative scheduling of the Lx_kit.
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is distributed under the terms of the GNU General Public License
+ * version 2.
+ */
+
+#ifndef _LX_KIT__ENV_H_
+#define _LX_KIT__ENV_H_
+
+/* Genode includes */
+#include <base/env.h>
+#include <base/heap.h>
+#include <timer_session/connection.h>
+
+namespace Lx_kit {
+
+	struct Scheduler;
+	struct Env;
+
+	Env &env();
+}
+
+
+struct Lx_kit::Scheduler
+{
+	/**
+	 * Execute all runnable tasks until each of them blocked
+	 */
+	void execute();
+};
+
+
+struct Lx_kit::Env
+{
+	Genode::Env       &env;
+	Genode::Heap       heap      { env.ram(), env.rm() };
+	Scheduler          scheduler { };
+	Timer::Connection  timer     { env };
+
+	Env(Genode::Env &env) : env { env } { }
+};
+
+#endif /* _LX_KIT__ENV_H_ */
@@ -0,0 +1,21 @@
+/*
+ * \brief  Initialization of the host-side lima driver environment
+ * \date   2026-10-17
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is distributed under the terms of the GNU General Public License
+ * version 2.
+ */
+
+#ifndef _LX_KIT__INIT_H_
+#define _LX_KIT__INIT_H_
+
+#include <base/env.h>
+#include <base/signal.h>
+
+namespace Lx_kit { void initialize(Genode::Env &, Genode::Signal_context &); }
+
+#endif /* _LX_KIT__INIT_H_ */
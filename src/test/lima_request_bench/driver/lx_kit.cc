@@ -0,0 +1,176 @@
+/*
+ * \brief  Host-side replacement of the Lx_kit tasks used by the lima driver
+ * \date   2026-10-17
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is distributed under the terms of the GNU General Public License
+ * version 2.
+ */
+
+/* Genode includes */
+#include <base/blockade.h>
+#include <base/sleep.h>
+#include <base/thread.h>
+#include <util/list.h>
+#include <util/reconstructible.h>
+
+/* emulation includes */
+#include <lx_emul/init.h>
+#include <lx_emul/task.h>
+#include <lx_kit/env.h>
+#include <lx_kit/init.h>
+
+/* local includes */
+#include <mock_drm.h>
+
+using namespace Genode;
+
+
+/*
+ * Each task is backed by a thread that only runs while the scheduler
+ * waits for the task to block again.
+ */
+struct task_struct : Thread, List<task_struct>::Element
+{
+	int (*_func)(void *);
+	void  *_args;
+
+	Blockade _resume { };
+	Blockade _yield  { };
+
+	bool runnable { true };
+	bool exited   { false };
+
+	task_struct(Genode::Env &env, int (*func)(void *), void *args)
+	:
+		Thread { env, "lx_task", Stack_size { 64*1024 } },
+		_func  { func }, _args { args }
+	{
+		start();
+	}
+
+	void entry() override
+	{
+		_resume.block();
+		_func(_args);
+
+		/* the thread is never destroyed as it may hold driver state */
+		exited = true;
+		_yield.wakeup();
+		sleep_forever();
+	}
+
+	void run()
+	{
+		_resume.wakeup();
+		_yield.block();
+	}
+
+	void yield()
+	{
+		_yield.wakeup();
+		_resume.block();
+	}
+};
+
+
+static List<task_struct> _tasks   { };
+static task_struct      *_current { nullptr };
+
+
+static task_struct *_create_task(int (*func)(void *), void *args)
+{
+	task_struct *task = new (Lx_kit::env().heap)
+		task_struct(Lx_kit::env().env, func, args);
+
+	_tasks.insert(task);
+	return task;
+}
+
+
+void Lx_kit::Scheduler::execute()
+{
+	/* tasks may be executed from within another task's context */
+	if (_current)
+		return;
+
+	for (bool progress = true; progress; ) {
+		progress = false;
+
+		for (task_struct *t = _tasks.first(); t; t = t->next()) {
+			if (!t->runnable || t->exited)
+				continue;
+
+			t->runnable = false;
+			_current    = t;
+			t->run();
+			_current    = nullptr;
+			progress    = true;
+		}
+	}
+}
+
+
+static Constructible<Lx_kit::Env> _lx_kit_env { };
+
+
+Lx_kit::Env &Lx_kit::env() { return *_lx_kit_env; }
+
+
+void Lx_kit::initialize(Genode::Env &env, Genode::Signal_context &)
+{
+	_lx_kit_env.construct(env);
+}
+
+
+extern "C" void lx_emul_task_unblock(struct task_struct *task)
+{
+	if (task)
+		task->runnable = true;
+}
+
+
+extern "C" void lx_emul_task_schedule(int block)
+{
+	if (!_current)
+		return;
+
+	if (!block)
+		_current->runnable = true;
+
+	_current->yield();
+}
+
+
+/*
+ * Counterparts of 'lx_user.c'
+ */
+
+extern "C" {
+
+	struct task_struct *lx_user_task      = nullptr;
+	void               *lx_user_task_args = nullptr;
+
+	int lx_user_task_func(void *);
+}
+
+
+extern "C" struct task_struct *lx_user_new_gpu_task(int (*func)(void*), void *args)
+{
+	return _create_task(func, args);
+}
+
+
+extern "C" void lx_user_destroy_gpu_task(struct task_struct *) { }
+
+
+extern "C" void lx_emul_start_kernel(void *)
+{
+	Lima_mock::init_drm(Lx_kit::env());
+
+	lx_user_task = _create_task(lx_user_task_func, lx_user_task_args);
+	Lx_kit::env().scheduler.execute();
+}
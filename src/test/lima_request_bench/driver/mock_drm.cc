@@ -0,0 +1,659 @@
+/*
+ * \brief  Mock DRM backend of the host-side lima driver
+ * \date   2026-10-17
+ *
+ * Implements the 'lx_drm' interface used by the lima driver without a GPU.
+ * The CPU time spent by the kernel on each operation is modelled by busy
+ * waiting, the execution of jobs by the GPU by signaling the out-sync
+ * object of a job once the job's time on its pipe has elapsed. Jobs of the
+ * same pipe are executed one after another. The latencies are configured
+ * via the '<mock_drm>' node of the driver's config:
+ *
+ * ! <mock_drm ioctl_us="2" gem_create_us="40" submit_us="30"
+ * !           gp_job_us="500" pp_job_us="2000" flush_ns_per_kib="60"
+ * !           resume_us="150"/>
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is distributed under the terms of the GNU General Public License
+ * version 2.
+ */
+
+/* Genode includes */
+#include <base/attached_ram_dataspace.h>
+#include <base/attached_rom_dataspace.h>
+#include <base/log.h>
+#include <util/reconstructible.h>
+
+/* local includes */
+#include <lx_drm.h>
+#include <mock_drm.h>
+#include <mock_submit.h>
+
+namespace Lima_mock {
+
+	struct Latency;
+	struct File;
+	struct Drm;
+}
+
+using namespace Lima_mock;
+
+
+struct Lima_mock::Latency
+{
+	uint64_t ioctl_us;
+	uint64_t gem_create_us;
+	uint64_t submit_us;
+	uint64_t job_us[NUM_PIPES];
+	uint64_t flush_ns_per_kib;
+	uint64_t resume_us;
+
+	static Latency from_node(Node const &node)
+	{
+		return {
+			.ioctl_us         = node.attribute_value("ioctl_us",         2UL),
+			.gem_create_us    = node.attribute_value("gem_create_us",    40UL),
+			.submit_us        = node.attribute_value("submit_us",        30UL),
+			.job_us           = { node.attribute_value("gp_job_us",      500UL),
+			                      node.attribute_value("pp_job_us",      2000UL) },
+			.flush_ns_per_kib = node.attribute_value("flush_ns_per_kib", 60UL),
+			.resume_us        = node.attribute_value("resume_us",        150UL),
+		};
+	}
+};
+
+
+/*
+ * State of one opened DRM file, i.e., of one GPU session
+ */
+struct Lima_mock::File
+{
+	enum { MAX_BOS = 4096, MAX_SYNCOBJS = 64 };
+
+	struct Bo
+	{
+		Attached_ram_dataspace *ds;
+		uint32_t                va;
+		bool                    owner;
+	};
+
+	struct Syncobj
+	{
+		bool     used;
+		bool     fenced;
+		uint64_t due_us;
+	};
+
+	Bo      bos[MAX_BOS]          { };
+	Syncobj syncobjs[MAX_SYNCOBJS] { };
+
+	unsigned ctxs { 0 };
+
+	/* handle 0 is invalid */
+	template <typename T, unsigned N>
+	static T *lookup(T (&array)[N], unsigned handle)
+	{
+		return (handle && handle < N) ? &array[handle] : nullptr;
+	}
+
+	Bo *bo(unsigned handle)
+	{
+		Bo *b = lookup(bos, handle);
+		return (b && b->ds) ? b : nullptr;
+	}
+
+	Syncobj *syncobj(unsigned handle)
+	{
+		Syncobj *s = lookup(syncobjs, handle);
+		return (s && s->used) ? s : nullptr;
+	}
+
+	/* first fit within the GPU virtual address space, as done by the VM */
+	uint32_t place(size_t size)
+	{
+		enum : uint64_t { VA_START = 0x100000, VA_END = 0xfff00000 };
+
+		uint64_t va = VA_START;
+		for (bool moved = true; moved; ) {
+			moved = false;
+			for (Bo const &bo : bos) {
+				if (!bo.ds)
+					continue;
+
+				uint64_t const end = uint64_t(bo.va) + bo.ds->size();
+				if (bo.va < va + size && va < end) {
+					va    = align_addr(end, 12);
+					moved = true;
+				}
+			}
+		}
+		return (va + size <= VA_END) ? uint32_t(va) : 0;
+	}
+
+	int alloc_bo(Bo const &bo, unsigned *handle)
+	{
+		for (unsigned i = 1; i < MAX_BOS; i++)
+			if (!bos[i].ds) {
+				bos[i]  = bo;
+				*handle = i;
+				return 0;
+			}
+		return -12; /* -ENOMEM */
+	}
+};
+
+
+struct Lima_mock::Drm
+{
+	Lx_kit::Env &_lx_env;
+
+	Latency const _latency;
+
+	uint64_t _now_us() { return _lx_env.timer.curr_time().trunc_to_plain_us().value; }
+
+	void _spin_us(uint64_t us)
+	{
+		for (uint64_t const end = _now_us() + us; _now_us() < end; ) { }
+	}
+
+	/* modelled CPU time below the timer resolution is accumulated */
+	uint64_t _debt_ns { 0 };
+
+	void _spin_ns(uint64_t ns)
+	{
+		_debt_ns += ns;
+		if (_debt_ns < 1000)
+			return;
+
+		_spin_us(_debt_ns/1000);
+		_debt_ns %= 1000;
+	}
+
+	/*
+	 * GPU model
+	 */
+
+	uint64_t _pipe_busy_until_us[NUM_PIPES] { };
+
+	struct Callback
+	{
+		uint64_t   due_us;
+		void     (*fn)(void *);
+		void      *arg;
+	};
+
+	enum { MAX_CALLBACKS = 512 };
+
+	Callback _callbacks[MAX_CALLBACKS] { };
+
+	Timer::Connection _gpu_timer { _lx_env.env };
+
+	Signal_handler<Drm> _gpu_timer_handler {
+		_lx_env.env.ep(), *this, &Drm::_handle_gpu_timer };
+
+	void _arm_gpu_timer()
+	{
+		uint64_t next = ~0ULL;
+		for (Callback const &c : _callbacks)
+			if (c.fn)
+				next = min(next, c.due_us);
+
+		if (next == ~0ULL)
+			return;
+
+		uint64_t const now = _now_us();
+		_gpu_timer.trigger_once(next > now ? next - now : 1);
+	}
+
+	void _handle_gpu_timer()
+	{
+		uint64_t const now = _now_us();
+
+		for (Callback &c : _callbacks) {
+			if (!c.fn || c.due_us > now)
+				continue;
+
+			Callback const fired = c;
+			c = Callback { };
+			fired.fn(fired.arg);
+		}
+
+		_arm_gpu_timer();
+	}
+
+	/*
+	 * Global names of exported buffer objects
+	 */
+
+	struct Name
+	{
+		Attached_ram_dataspace *ds;
+		uint32_t                va;
+	};
+
+	enum { MAX_NAMES = 256 };
+
+	Name _names[MAX_NAMES] { };
+
+	Drm(Lx_kit::Env &lx_env, Node const &config)
+	:
+		_lx_env  { lx_env },
+		_latency { Latency::from_node(config) }
+	{
+		_gpu_timer.sigh(_gpu_timer_handler);
+	}
+
+	void ioctl() { _spin_us(_latency.ioctl_us); }
+
+	bool _suspended { false };
+
+	int suspend()
+	{
+		uint64_t const now = _now_us();
+		for (uint64_t const until_us : _pipe_busy_until_us)
+			if (until_us > now)
+				return -16; /* -EBUSY */
+
+		_suspended = true;
+		return 0;
+	}
+
+	int resume()
+	{
+		if (_suspended)
+			_spin_us(_latency.resume_us);
+
+		_suspended = false;
+		return 0;
+	}
+
+	File *open()
+	{
+		ioctl();
+		try { return new (_lx_env.heap) File(); }
+		catch (...) { return nullptr; }
+	}
+
+	void close(File &file)
+	{
+		for (unsigned i = 1; i < File::MAX_BOS; i++)
+			(void)gem_close(file, i);
+
+		destroy(_lx_env.heap, &file);
+	}
+
+	int gem_create(File &file, uint32_t va, size_t size, unsigned *handle)
+	{
+		_spin_us(_latency.gem_create_us);
+
+		Attached_ram_dataspace *ds = nullptr;
+		try {
+			ds = new (_lx_env.heap)
+				Attached_ram_dataspace(_lx_env.env.ram(), _lx_env.env.rm(), size);
+		} catch (...) { return -12; /* -ENOMEM */ }
+
+		if (!va)
+			va = file.place(size);
+
+		int const err = va ? file.alloc_bo({ .ds = ds, .va = va, .owner = true }, handle)
+		                   : -28; /* -ENOSPC */
+		if (err)
+			destroy(_lx_env.heap, ds);
+		return err;
+	}
+
+	int gem_close(File &file, unsigned handle)
+	{
+		File::Bo *bo = file.bo(handle);
+		if (!bo)
+			return -22; /* -EINVAL */
+
+		if (bo->owner) {
+			for (Name &n : _names)
+				if (n.ds == bo->ds)
+					n = Name { };
+			destroy(_lx_env.heap, bo->ds);
+		}
+
+		*bo = File::Bo { };
+		return 0;
+	}
+
+	int gem_flink(File &file, unsigned handle, unsigned *name)
+	{
+		ioctl();
+
+		File::Bo *bo = file.bo(handle);
+		if (!bo)
+			return -22;
+
+		for (unsigned i = 1; i < MAX_NAMES; i++)
+			if (_names[i].ds == bo->ds) {
+				*name = i;
+				return 0;
+			}
+
+		for (unsigned i = 1; i < MAX_NAMES; i++)
+			if (!_names[i].ds) {
+				_names[i] = Name { .ds = bo->ds, .va = bo->va };
+				*name = i;
+				return 0;
+			}
+
+		return -28; /* -ENOSPC */
+	}
+
+	int gem_open(File &file, unsigned name, unsigned *handle,
+	             unsigned long long *size)
+	{
+		ioctl();
+
+		Name const *n = (name && name < MAX_NAMES) ? &_names[name] : nullptr;
+		if (!n || !n->ds)
+			return -2; /* -ENOENT */
+
+		*size = n->ds->size();
+		return file.alloc_bo({ .ds = n->ds, .va = n->va, .owner = false }, handle);
+	}
+
+	Dataspace_capability lookup_cap(File &file, unsigned long long offset)
+	{
+		File::Bo *bo = file.bo(unsigned(offset >> 12));
+		return bo ? bo->ds->cap() : Dataspace_capability();
+	}
+
+	bool _signaled(File::Syncobj const &s, uint64_t now)
+	{
+		return !s.fenced || s.due_us <= now;
+	}
+
+	int syncobj_wait(File &file, unsigned const *handles, unsigned count,
+	                 bool wait_all)
+	{
+		ioctl();
+
+		uint64_t const now = _now_us();
+
+		unsigned signaled = 0;
+		for (unsigned i = 0; i < count; i++) {
+			File::Syncobj *s = file.syncobj(handles[i]);
+			if (!s)
+				return -22;
+
+			if (_signaled(*s, now))
+				signaled++;
+		}
+
+		bool const done = wait_all ? signaled == count : signaled > 0;
+		return done ? 0 : 1;
+	}
+
+	int syncobj_signal_callback(File &file, unsigned handle,
+	                            void (*fn)(void *), void *arg)
+	{
+		File::Syncobj *s = file.syncobj(handle);
+		if (!s || !s->fenced)
+			return -22;
+
+		if (_signaled(*s, _now_us())) {
+			fn(arg);
+			return 0;
+		}
+
+		for (Callback &c : _callbacks)
+			if (!c.fn) {
+				c = Callback { .due_us = s->due_us, .fn = fn, .arg = arg };
+				_arm_gpu_timer();
+				return 0;
+			}
+
+		return -12;
+	}
+
+	int submit(File &file, Submit const &submit)
+	{
+		_spin_us(_latency.submit_us);
+
+		File::Syncobj *s = file.syncobj(submit.out_sync);
+		if (!s || submit.pipe >= NUM_PIPES)
+			return -22;
+
+		/* the job starts not before its in-sync fences are signaled */
+		uint64_t start_us = _now_us();
+		for (uint32_t const handle : submit.in_sync)
+			if (File::Syncobj const *in = file.syncobj(handle))
+				if (in->fenced)
+					start_us = max(start_us, in->due_us);
+
+		uint64_t &busy_until = _pipe_busy_until_us[submit.pipe];
+
+		busy_until = max(busy_until, start_us) + _latency.job_us[submit.pipe];
+
+		s->fenced = true;
+		s->due_us = busy_until;
+		return 0;
+	}
+
+	void flush(size_t size)
+	{
+		_spin_ns((size/1024)*_latency.flush_ns_per_kib);
+	}
+};
+
+
+static Constructible<Drm> _drm { };
+
+
+void Lima_mock::init_drm(Lx_kit::Env &lx_env)
+{
+	Attached_rom_dataspace config { lx_env.env, "config" };
+
+	config.node().with_sub_node("mock_drm",
+		[&] (Node const &node) { _drm.construct(lx_env, node); },
+		[&]                    { _drm.construct(lx_env, config.node()); });
+
+	log("mock DRM backend initialized");
+}
+
+
+static File &_file(void *p) { return *static_cast<File *>(p); }
+
+
+/*
+ * Counterparts of 'emul.cc'
+ */
+
+extern "C" void lx_emul_mem_cache_clean_invalidate(const void *, unsigned long size)
+{
+	_drm->flush(size);
+}
+
+
+Genode::Dataspace_capability genode_lookup_cap(void *drm, unsigned long long offset,
+                                               unsigned long)
+{
+	return _drm->lookup_cap(_file(drm), offset);
+}
+
+
+/*
+ * Counterparts of 'lx_emul.c'
+ */
+
+extern "C" void *lx_drm_open(void) { return _drm->open(); }
+
+extern "C" void lx_drm_close(void *p) { _drm->close(_file(p)); }
+
+extern "C" int lx_drm_gpu_suspend(void) { return _drm->suspend(); }
+
+extern "C" int lx_drm_gpu_resume(void) { return _drm->resume(); }
+
+
+static Submit       &_submit(void *p)       { return *static_cast<Submit *>(p); }
+static Submit const &_submit(void const *p) { return *static_cast<Submit const *>(p); }
+
+extern "C" void lx_drm_gem_submit_ctx_id(void *p, unsigned id) {
+	_submit(p).ctx = id; }
+
+extern "C" void lx_drm_gem_submit_set_out_sync(void *p, unsigned id) {
+	_submit(p).out_sync = id; }
+
+extern "C" unsigned lx_drm_gem_submit_bo_count(void const *p) {
+	return _submit(p).nr_bos; }
+
+extern "C" unsigned *lx_drm_gem_submit_bo_handle(void *p, unsigned index) {
+	return &_submit(p).bo(index).handle; }
+
+extern "C" bool lx_drm_gem_submit_bo_read(void *p, unsigned index) {
+	return _submit(p).bo(index).flags & Submit_bo::READ; }
+
+extern "C" unsigned lx_drm_gem_submit_out_sync(void const *p) {
+	return _submit(p).out_sync; }
+
+extern "C" unsigned *lx_drm_gem_submit_in_sync(void *p, unsigned index) {
+	return index < 2 ? &_submit(p).in_sync[index] : nullptr; }
+
+extern "C" unsigned lx_drm_gem_submit_pipe(void const *p) {
+	return _submit(p).pipe; }
+
+
+extern "C" int lx_drm_gem_close(void *p, unsigned int handle)
+{
+	_drm->ioctl();
+	return _drm->gem_close(_file(p), handle);
+}
+
+
+extern "C" int lx_drm_gem_flink(void *p, unsigned int handle, unsigned int *name)
+{
+	return _drm->gem_flink(_file(p), handle, name);
+}
+
+
+extern "C" int lx_drm_gem_open(void *p, unsigned int name, unsigned int *handle,
+                               unsigned long long *size)
+{
+	return _drm->gem_open(_file(p), name, handle, size);
+}
+
+
+extern "C" int lx_drm_ioctl_syncobj_create(void *p, unsigned int *handle)
+{
+	_drm->ioctl();
+
+	File &file = _file(p);
+	for (unsigned i = 1; i < File::MAX_SYNCOBJS; i++)
+		if (!file.syncobjs[i].used) {
+			file.syncobjs[i] = File::Syncobj { .used = true, .fenced = false, .due_us = 0 };
+			*handle = i;
+			return 0;
+		}
+	return -12;
+}
+
+
+extern "C" int lx_drm_ioctl_syncobj_destroy(void *p, unsigned int handle)
+{
+	_drm->ioctl();
+
+	File::Syncobj *s = _file(p).syncobj(handle);
+	if (!s)
+		return -22;
+
+	*s = File::Syncobj { };
+	return 0;
+}
+
+
+extern "C" int lx_drm_ioctl_syncobj_wait(void *p, unsigned int const *handles,
+                                         unsigned int count, bool wait_all)
+{
+	return _drm->syncobj_wait(_file(p), handles, count, wait_all);
+}
+
+
+extern "C" int lx_drm_syncobj_signal_callback(void *p, unsigned int handle,
+                                              void (*fn)(void *), void *arg)
+{
+	return _drm->syncobj_signal_callback(_file(p), handle, fn, arg);
+}
+
+
+extern "C" int lx_drm_syncobj_transfer(void *src_p, unsigned int src_handle,
+                                       void *dst_p, unsigned int dst_handle)
+{
+	_drm->ioctl();
+
+	File::Syncobj const *src = _file(src_p).syncobj(src_handle);
+	File::Syncobj       *dst = _file(dst_p).syncobj(dst_handle);
+	if (!src || !dst)
+		return -22;
+
+	*dst = *src;
+	return 0;
+}
+
+
+extern "C" int lx_drm_ioctl_lima_ctx_create(void *p, unsigned int *id)
+{
+	_drm->ioctl();
+	*id = ++_file(p).ctxs;
+	return 0;
+}
+
+
+extern "C" int lx_drm_ioctl_lima_ctx_free(void *, unsigned int)
+{
+	_drm->ioctl();
+	return 0;
+}
+
+
+extern "C" int lx_drm_ioctl_lima_gem_create(void *p, unsigned va, unsigned long size,
+                                            unsigned int *handle)
+{
+	return _drm->gem_create(_file(p), va, size, handle);
+}
+
+
+extern "C" int lx_drm_ioctl_lima_gem_info(void *p, unsigned int handle,
+                                          unsigned int *va,
+                                          unsigned long long *offset)
+{
+	_drm->ioctl();
+
+	File::Bo *bo = _file(p).bo(handle);
+	if (!bo)
+		return -22;
+
+	*va     = bo->va;
+	*offset = (unsigned long long)handle << 12;
+	return 0;
+}
+
+
+extern "C" int lx_drm_ioctl_lima_gem_param(void *, unsigned char param,
+                                           unsigned long long *value)
+{
+	enum { NUM_PP = 0x01 };
+
+	_drm->ioctl();
+	*value = (param == NUM_PP) ? 4 : 0;
+	return 0;
+}
+
+
+extern "C" int lx_drm_ioctl_lima_gem_wait(void *p, unsigned int handle, unsigned int)
+{
+	_drm->ioctl();
+	return _file(p).bo(handle) ? 0 : -22;
+}
+
+
+extern "C" int lx_drm_ioctl_lima_gem_submit(void *p, unsigned long submit)
+{
+	return _drm->submit(_file(p), *reinterpret_cast<Submit const *>(submit));
+}
@@ -0,0 +1,21 @@
+/*
+ * \brief  Mock DRM backend of the host-side lima driver
+ * \date   2026-10-17
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is distributed under the terms of the GNU General Public License
+ * version 2.
+ */
+
+#ifndef _MOCK_DRM_H_
+#define _MOCK_DRM_H_
+
+/* emulation includes */
+#include <lx_kit/env.h>
+
+namespace Lima_mock { void init_drm(Lx_kit::Env &); }
+
+#endif /* _MOCK_DRM_H_ */
@@ -0,0 +1,9 @@
+TARGET   = test-lima_mock_gpu
+LIBS     = base
+INC_DIR += $(PRG_DIR)/include $(PRG_DIR) $(PRG_DIR)/..
+INC_DIR += $(REP_DIR)/src/driver/gpu/lima
+SRC_CC  += main.cc
+SRC_CC  += lx_kit.cc
+SRC_CC  += mock_drm.cc
+
+vpath main.cc $(REP_DIR)/src/driver/gpu/lima
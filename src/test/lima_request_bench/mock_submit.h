@@ -0,0 +1,63 @@
+/*
+ * \brief  Submit layout interpreted by the mock DRM backend
+ * \date   2026-10-17
+ *
+ * Mirrors 'struct drm_lima_gem_submit' as stored by lima clients in the
+ * submit buffer object passed to 'Gpu::Session::execute'.
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is distributed under the terms of the GNU General Public License
+ * version 2.
+ */
+
+#ifndef _MOCK_SUBMIT_H_
+#define _MOCK_SUBMIT_H_
+
+/* Genode includes */
+#include <base/stdint.h>
+
+namespace Lima_mock {
+
+	using namespace Genode;
+
+	enum { PIPE_GP = 0, PIPE_PP = 1, NUM_PIPES = 2 };
+
+	struct Submit_bo;
+	struct Submit;
+}
+
+
+struct Lima_mock::Submit_bo
+{
+	enum { READ = 0x01, WRITE = 0x02 };
+
+	uint32_t handle;
+	uint32_t flags;
+};
+
+
+struct Lima_mock::Submit
+{
+	uint32_t ctx;
+	uint32_t pipe;
+	uint32_t nr_bos;
+	uint32_t frame_size;
+
+	/* offsets relative to the start of the submit */
+	uint64_t bos;
+	uint64_t frame;
+
+	uint32_t flags;
+	uint32_t in_sync[2];
+	uint32_t out_sync;
+
+	Submit_bo &bo(unsigned i)
+	{
+		return reinterpret_cast<Submit_bo *>(reinterpret_cast<char *>(this) + bos)[i];
+	}
+};
+
+#endif /* _MOCK_SUBMIT_H_ */